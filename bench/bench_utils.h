@@ -0,0 +1,65 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+namespace bench {
+
+    // Sink used to keep the optimizer from discarding benchmarked work
+    extern volatile uint64_t sink;
+
+    // Runs fn `iterations` times and returns the average cost in nanoseconds
+    template<typename F>
+    double measure_ns(uint32_t iterations, F fn) {
+        // warm up caches and branch predictors
+        for (uint32_t i = 0; i < iterations / 10 + 1; i++) {
+            fn();
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < iterations; i++) {
+            fn();
+        }
+        const auto end = std::chrono::steady_clock::now();
+
+        const double total = std::chrono::duration<double, std::nano>(end - start).count();
+        return total / iterations;
+    }
+
+    inline double mb_per_s(double ns, size_t bytes) {
+        if (ns <= 0) {
+            return 0;
+        }
+        return (bytes / ns) * 1e9 / (1024.0 * 1024.0);
+    }
+
+    inline void print_header(const char *title) {
+        printf("\n%s\n", title);
+        printf("%-32s %12s %12s\n", "case", "ns/op", "MB/s");
+        printf("--------------------------------------------------------------------------\n");
+    }
+
+    inline void print_row(const char *name, double ns, size_t bytes) {
+        if (bytes > 0) {
+            printf("%-32s %12.1f %12.2f\n", name, ns, mb_per_s(ns, bytes));
+        } else {
+            printf("%-32s %12.1f %12s\n", name, ns, "-");
+        }
+    }
+}
@@ -0,0 +1,481 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+// Host-side benchmarks for the transaction parser
+//
+// Usage: parser_bench [--iterations N] [--suite corpus|streaming|varint|amounts|stages]
+//
+// Build with -DCMAKE_BUILD_TYPE=Release to get meaningful numbers.
+// Correctness is covered by the parser_tests target.
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "bench_utils.h"
+#include "tx_builder.h"
+
+#include "parser.h"
+#include "parser_impl.h"
+#include "chain.h"
+#include "zxmacros.h"
+
+volatile uint64_t bench::sink = 0;
+
+namespace {
+    // Display geometries as used by view_internal.h
+    struct screen_t {
+        const char *name;
+        uint16_t keyLen;
+        uint16_t valueLen;
+    };
+
+    const screen_t screens[] = {
+            {"nanos", 32 + 1, 2 * 18 + 1},
+            {"nanox", 64, 4096},
+    };
+
+    bool parse(const bench::bytes_t &tx, parser_context_t *ctx) {
+        parser_error_t err = parser_parse(ctx, (uint8_t *) tx.data(), tx.size());
+        if (err != parser_ok) {
+            fprintf(stderr, "parser_parse: %s\n", parser_getErrorDescription(err));
+            return false;
+        }
+        err = parser_validate(bool_false);
+        if (err != parser_ok) {
+            fprintf(stderr, "parser_validate: %s\n", parser_getErrorDescription(err));
+            return false;
+        }
+        return true;
+    }
+
+    // Renders every item and every page, the same way the review flow walks a transaction
+    uint32_t render_all(parser_context_t *ctx, const screen_t &screen, char *key, char *value) {
+        uint32_t screensRendered = 0;
+        const uint8_t numItems = parser_getNumItems(ctx);
+        for (uint8_t idx = 0; idx < numItems; idx++) {
+            uint8_t pageCount = 1;
+            for (uint8_t pageIdx = 0; pageIdx < pageCount; pageIdx++) {
+                parser_getItem(ctx, idx,
+                               key, screen.keyLen,
+                               value, screen.valueLen,
+                               pageIdx, &pageCount);
+                bench::sink += (uint8_t) value[0];
+                screensRendered++;
+            }
+        }
+        return screensRendered;
+    }
+
+    bool bench_corpus(const std::vector<bench::corpus_entry_t> &corpus, uint32_t iterations) {
+        parser_context_t ctx;
+        std::vector<char> key(4096);
+        std::vector<char> value(4096);
+
+        bench::print_header("parser_parse / parser_validate / parser_getItem");
+
+        for (const auto &entry : corpus) {
+            if (!parse(entry.data, &ctx)) {
+                return false;
+            }
+
+            printf("%s: %zu bytes, %d items\n", entry.name, entry.data.size(), parser_getNumItems(&ctx));
+
+            double ns = bench::measure_ns(iterations, [&]() {
+                bench::sink += parser_parse(&ctx, (uint8_t *) entry.data.data(), entry.data.size());
+            });
+            bench::print_row("  parser_parse", ns, entry.data.size());
+
+            ns = bench::measure_ns(iterations, [&]() {
+                bench::sink += parser_validate(bool_false);
+            });
+            bench::print_row("  parser_validate", ns, entry.data.size());
+
+            for (const auto &screen : screens) {
+                const uint32_t count = render_all(&ctx, screen, key.data(), value.data());
+                ns = bench::measure_ns(iterations, [&]() {
+                    parser_resetRenderCache();
+                    render_all(&ctx, screen, key.data(), value.data());
+                });
+
+                char label[64];
+                snprintf(label, sizeof(label), "  getItem all [%s, %d scr]", screen.name, count);
+                bench::print_row(label, ns, 0);
+
+                // Going through the review again only slices already rendered items
+                ns = bench::measure_ns(iterations, [&]() {
+                    render_all(&ctx, screen, key.data(), value.data());
+                });
+                snprintf(label, sizeof(label), "  getItem all again [%s]", screen.name);
+                bench::print_row(label, ns, 0);
+
+                // What the review needs to know to move around, nothing is rendered
+                ns = bench::measure_ns(iterations, [&]() {
+                    const uint8_t numItems = parser_getNumItems(&ctx);
+                    for (uint8_t idx = 0; idx < numItems; idx++) {
+                        uint8_t pageCount;
+                        bench::sink += parser_getItemPageCount(idx, screen.valueLen, &pageCount);
+                        bench::sink += pageCount;
+                    }
+                });
+                snprintf(label, sizeof(label), "  page counts all [%s]", screen.name);
+                bench::print_row(label, ns, 0);
+            }
+
+            ns = bench::measure_ns(iterations, [&]() {
+                parser_parse(&ctx, (uint8_t *) entry.data.data(), entry.data.size());
+                parser_validate(bool_false);
+                render_all(&ctx, screens[0], key.data(), value.data());
+            });
+            bench::print_row("  total sign path [nanos]", ns, entry.data.size());
+        }
+
+        return true;
+    }
+
+    // Largest payload carried by a single INS_SIGN_ED25519 APDU
+    const uint16_t apdu_chunk_size = 250;
+
+    parser_error_t parse_chunked(parser_context_t *ctx, const bench::bytes_t &tx, uint16_t chunkSize) {
+        parser_init(ctx, nullptr, 0);
+        for (uint16_t received = chunkSize; received < tx.size(); received += chunkSize) {
+            parser_parseChunk(ctx, tx.data(), received);
+        }
+        return parser_parseEnd(ctx, tx.data(), tx.size());
+    }
+
+    bool bench_streaming(const std::vector<bench::corpus_entry_t> &corpus, uint32_t iterations) {
+        parser_context_t ctx;
+
+        bench::print_header("incremental parsing (250 byte APDU chunks)");
+
+        for (const auto &entry : corpus) {
+            printf("%s: %zu bytes\n", entry.name, entry.data.size());
+
+            double ns = bench::measure_ns(iterations, [&]() {
+                bench::sink += parse_chunked(&ctx, entry.data, apdu_chunk_size);
+            });
+            bench::print_row("  all chunks + parser_parseEnd", ns, entry.data.size());
+
+            // Snapshot the state right before the last chunk arrives
+            const uint16_t lastChunkStart = ((entry.data.size() - 1) / apdu_chunk_size) * apdu_chunk_size;
+            parser_init(&ctx, nullptr, 0);
+            if (lastChunkStart > 0) {
+                parser_parseChunk(&ctx, entry.data.data(), lastChunkStart);
+            }
+            const parser_context_t ctxSnapshot = ctx;
+            const parser_tx_t txSnapshot = parser_tx_obj;
+
+            ns = bench::measure_ns(iterations, [&]() {
+                ctx = ctxSnapshot;
+                parser_tx_obj = txSnapshot;
+                bench::sink += parser_parseChunk(&ctx, entry.data.data(), entry.data.size());
+                bench::sink += parser_parseEnd(&ctx, entry.data.data(), entry.data.size());
+            });
+            bench::print_row("  last chunk only", ns, entry.data.size() - lastChunkStart);
+        }
+
+        return true;
+    }
+
+    // Mix of varints seen when walking a bnsd transaction: mostly 1 byte tags/lengths,
+    // 2 byte tags (field 51), and a few large amounts / nonces
+    bench::bytes_t build_varint_stream(size_t count) {
+        const uint64_t values[] = {0x0a, 0x12, 20, 0x1a, 410, 8, 0x22, 10, 0x2a, 128,
+                                   0x08, 999999999, 0x10, 999999999999999ull, 0x22, 300};
+        bench::bytes_t out;
+        for (size_t i = 0; i < count; i++) {
+            bench::pb_varint(out, values[i % (sizeof(values) / sizeof(values[0]))]);
+        }
+        return out;
+    }
+
+    template<typename F>
+    uint64_t decode_all(F decoder, const bench::bytes_t &stream) {
+        parser_context_t ctx;
+        parser_init_context(&ctx, stream.data(), stream.size());
+        uint64_t acc = 0, v;
+        while (ctx.offset < ctx.bufferSize) {
+            ctx.lastConsumed = 0;
+            if (decoder(&ctx, &v) != parser_ok) {
+                break;
+            }
+            ctx.offset += ctx.lastConsumed;
+            acc += v;
+        }
+        return acc;
+    }
+
+    bool bench_varint(uint32_t iterations) {
+        const size_t count = 1024;
+        const bench::bytes_t stream = build_varint_stream(count);
+        const uint32_t loops = iterations / 100 + 1;
+
+        bench::print_header("_readRawVarint (per varint, bnsd field mix)");
+
+        const double ns = bench::measure_ns(loops, [&]() {
+            bench::sink += decode_all(_readRawVarint, stream);
+        });
+        bench::print_row("fast path", ns / count, 0);
+
+        return true;
+    }
+
+    // Amounts with every number of whole (0..IOV_WHOLE_DIGITS) and fractional (0..IOV_FRAC_DIGITS) digits
+    std::vector<parser_coin_t> build_amounts() {
+        std::vector<parser_coin_t> amounts;
+        uint64_t seed = 0x9E3779B97F4A7C15u;
+        for (int w = 0; w <= IOV_WHOLE_DIGITS; w++) {
+            for (int f = 0; f <= IOV_FRAC_DIGITS; f++) {
+                parser_coin_t coin = {};
+                int64_t wMax = 1, fMax = 1;
+                for (int i = 0; i < w; i++) wMax *= 10;
+                for (int i = 0; i < f; i++) fMax *= 10;
+                seed = seed * 6364136223846793005u + 1442695040888963407u;
+                // the top digit is never 0 and trailing zeros are common
+                coin.whole = w == 0 ? 0 : wMax / 10 + (int64_t) ((seed >> 11u) % (uint64_t) (wMax - wMax / 10));
+                coin.fractional = f == 0 ? 0 : fMax / 10 + (int64_t) ((seed >> 33u) % (uint64_t) (fMax - fMax / 10));
+                amounts.push_back(coin);
+                coin.whole = wMax - 1;
+                coin.fractional = fMax / 10 * (f > 0);
+                amounts.push_back(coin);
+            }
+        }
+        return amounts;
+    }
+
+    bool bench_amounts(uint32_t iterations) {
+        const auto amounts = build_amounts();
+
+        const uint32_t loops = iterations / 100 + 1;
+        char out[64];
+
+        bench::print_header("amount formatting (per amount, 0-15 whole x 0-9 fractional digits)");
+
+        const struct {
+            const char *name;
+            uint8_t flags;
+        } variants[] = {
+                {"plain", 0},
+                {"friendly", PARSER_AMOUNT_FRIENDLY},
+                {"friendly, trim + group", PARSER_AMOUNT_FRIENDLY | PARSER_AMOUNT_TRIM | PARSER_AMOUNT_GROUP},
+        };
+        for (const auto &v : variants) {
+            double ns = bench::measure_ns(loops, [&]() {
+                for (const auto &coin : amounts) {
+                    parser_formatCoin(out, sizeof(out), &coin, v.flags);
+                    bench::sink += (uint8_t) out[0];
+                }
+            });
+            bench::print_row(v.name, ns / amounts.size(), 0);
+        }
+
+        return true;
+    }
+
+    // Pointer based layout that parser_tx_t replaced, kept to compare sizes
+    namespace reference {
+        struct coin_t {
+            uint8_t seen;
+            int64_t whole;
+            int64_t fractional;
+            const uint8_t *tickerPtr;
+            uint16_t tickerLen;
+        };
+
+        struct tx_t {
+            const uint32_t *version;
+            uint8_t chainIDLen;
+            const uint8_t *chainID;
+            int64_t nonce;
+            uint8_t seen;
+            const uint8_t *feesPtr;
+            uint16_t feesLen;
+            struct {
+                uint8_t seen;
+                const uint8_t *payerPtr;
+                uint16_t payerLen;
+                const uint8_t *coinPtr;
+                uint16_t coinLen;
+                coin_t coin;
+            } fees;
+            const uint8_t *multisigPtr;
+            uint16_t multisigLen;
+            struct {
+                uint8_t count;
+                uint64_t values[8];             // the entry limit of that layout
+            } multisig;
+            const uint8_t *sendmsgPtr;
+            uint16_t sendmsgLen;
+            struct {
+                uint8_t seen;
+                const uint8_t *metadataPtr;
+                uint16_t metadataLen;
+                struct {
+                    uint8_t seen;
+                    uint32_t schema;
+                } metadata;
+                const uint8_t *sourcePtr;
+                uint16_t sourceLen;
+                const uint8_t *destinationPtr;
+                uint16_t destinationLen;
+                const uint8_t *amountPtr;
+                uint16_t amountLen;
+                coin_t amount;
+                const uint8_t *memoPtr;
+                uint16_t memoLen;
+                const uint8_t *refPtr;
+                uint16_t refLen;
+            } sendmsg;
+        };
+    }
+
+    // Same size as the baseline parser_tx_obj on 64 bit hosts
+    static_assert(sizeof(void *) != 8 || sizeof(reference::tx_t) == 392, "reference::tx_t does not match the baseline");
+
+    void report_layout() {
+        printf("\nparsed transaction (this host, %d bit pointers)\n", (int) (8 * sizeof(void *)));
+        printf("%-32s %12zu bytes\n", "parser_tx_t (pointers)", sizeof(reference::tx_t));
+        printf("%-32s %12zu bytes\n", "parser_tx_t (spans)", sizeof(parser_tx_t));
+    }
+
+    // Breaks getItem down into the stages that make it up
+    bool bench_stages(const std::vector<bench::corpus_entry_t> &corpus, uint32_t iterations) {
+        parser_context_t ctx;
+        const auto &worst = corpus.back();
+        if (!parse(worst.data, &ctx)) {
+            return false;
+        }
+
+        report_layout();
+        bench::print_header("getItem stages (worst case transaction)");
+
+        const uint8_t *chainID = parser_getChainID();
+        const uint8_t *source, *memoPtr;
+        if (parser_getSpan(&parser_tx_obj.sendmsg.source, &source) != parser_ok ||
+            parser_getSpan(&parser_tx_obj.sendmsg.memo, &memoPtr) != parser_ok) {
+            return false;
+        }
+        const uint16_t sourceLen = parser_tx_obj.sendmsg.source.len;
+        const uint16_t memoLen = parser_tx_obj.sendmsg.memo.len;
+
+        char addr[IOV_ADDR_MAXLEN + 1];
+        double ns = bench::measure_ns(iterations, [&]() {
+            parser_getAddress(parser_getHRP(),
+                              addr, sizeof(addr),
+                              source, sourceLen);
+            bench::sink += (uint8_t) addr[0];
+        });
+        bench::print_row("bech32 (parser_getAddress)", ns, sourceLen);
+
+        ns = bench::measure_ns(iterations, [&]() {
+            bench::sink += parser_checkChars(chainID, parser_tx_obj.chainIDLen,
+                                             PARSER_CHARCLASS_CHAINID | PARSER_CHARCLASS_READABLE);
+        });
+        bench::print_row("chain ID characters", ns, parser_tx_obj.chainIDLen);
+
+        ns = bench::measure_ns(iterations, [&]() {
+            bench::sink += chain_lookup(chainID, parser_tx_obj.chainIDLen);
+        });
+        bench::print_row("chain lookup", ns, parser_tx_obj.chainIDLen);
+
+        parser_coin_t coin;
+        ns = bench::measure_ns(iterations, [&]() {
+            bench::sink += parser_getCoin(&parser_tx_obj.sendmsg.amount, &coin);
+        });
+        bench::print_row("decode amount (parser_getCoin)", ns, parser_tx_obj.sendmsg.amount.len);
+
+        char amount[64];
+        ns = bench::measure_ns(iterations, [&]() {
+            parser_formatAmountFriendly(amount, sizeof(amount), &coin);
+            bench::sink += (uint8_t) amount[0];
+        });
+        bench::print_row("format amount (friendly)", ns, 0);
+
+        ns = bench::measure_ns(iterations, [&]() {
+            parser_formatAmount(amount, sizeof(amount), &coin);
+            bench::sink += (uint8_t) amount[0];
+        });
+        bench::print_row("format amount (plain)", ns, 0);
+
+        char memo[TX_MEMOLEN_MAX + 1];
+        ns = bench::measure_ns(iterations, [&]() {
+            asciify_n((const char *) memoPtr, memoLen, memo);
+            bench::sink += (uint8_t) memo[0];
+        });
+        bench::print_row("memo asciify", ns, memoLen);
+
+        for (const auto &screen : screens) {
+            std::vector<char> value(screen.valueLen);
+            uint8_t pageCount = 0;
+            ns = bench::measure_ns(iterations, [&]() {
+                parser_arrayToString(value.data(), screen.valueLen,
+                                     (const uint8_t *) memo, strlen(memo),
+                                     0, &pageCount);
+                bench::sink += pageCount;
+            });
+
+            char label[64];
+            snprintf(label, sizeof(label), "paging memo [%s]", screen.name);
+            bench::print_row(label, ns, strlen(memo));
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = 100000;
+    const char *suite = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = (uint32_t) strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--suite") == 0 && i + 1 < argc) {
+            suite = argv[++i];
+        }
+    }
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    const auto corpus = bench::build_corpus();
+    const auto selected = [&](const char *name) {
+        return suite == nullptr || strcmp(suite, name) == 0;
+    };
+
+    if (selected("corpus") && !bench_corpus(corpus, iterations)) {
+        return EXIT_FAILURE;
+    }
+
+    if (selected("streaming") && !bench_streaming(corpus, iterations)) {
+        return EXIT_FAILURE;
+    }
+
+    if (selected("varint") && !bench_varint(iterations)) {
+        return EXIT_FAILURE;
+    }
+
+    if (selected("amounts") && !bench_amounts(iterations)) {
+        return EXIT_FAILURE;
+    }
+
+    if (selected("stages") && !bench_stages(corpus, iterations)) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,148 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "parser_txdef.h"
+
+// Minimal protobuf writer used to build a bnsd SendMsg corpus for host benchmarks
+namespace bench {
+
+    typedef std::vector<uint8_t> bytes_t;
+
+    inline void pb_varint(bytes_t &out, uint64_t v) {
+        while (v >= 0x80) {
+            out.push_back((uint8_t) (v | 0x80u));
+            v >>= 7u;
+        }
+        out.push_back((uint8_t) v);
+    }
+
+    inline void pb_tag(bytes_t &out, uint32_t field, uint8_t wireType) {
+        pb_varint(out, ((uint64_t) field << 3u) | wireType);
+    }
+
+    inline void pb_uint(bytes_t &out, uint32_t field, uint64_t v) {
+        pb_tag(out, field, 0);
+        pb_varint(out, v);
+    }
+
+    inline void pb_bytes(bytes_t &out, uint32_t field, const bytes_t &v) {
+        pb_tag(out, field, 2);
+        pb_varint(out, v.size());
+        out.insert(out.end(), v.begin(), v.end());
+    }
+
+    inline void pb_string(bytes_t &out, uint32_t field, const std::string &v) {
+        pb_bytes(out, field, bytes_t(v.begin(), v.end()));
+    }
+
+    inline bytes_t address(uint8_t seed) {
+        bytes_t a(20);
+        for (size_t i = 0; i < a.size(); i++) {
+            a[i] = (uint8_t) (seed * 31u + i * 7u);
+        }
+        return a;
+    }
+
+    // No ticker field at all if ticker is null
+    inline bytes_t coin(uint64_t whole, uint64_t fractional, const char *ticker) {
+        bytes_t c;
+        if (whole > 0) pb_uint(c, 1, whole);
+        if (fractional > 0) pb_uint(c, 2, fractional);
+        if (ticker != nullptr) pb_string(c, 3, ticker);
+        return c;
+    }
+
+    struct tx_spec_t {
+        std::string chainID;
+        uint64_t nonce;
+        uint64_t amountWhole;
+        uint64_t amountFrac;
+        uint64_t feeWhole;
+        uint64_t feeFrac;
+        std::string memo;
+        uint8_t multisigCount;
+    };
+
+    // version | len(chainID) | chainID | nonce (BE) | serialized transaction
+    inline bytes_t build_tx(const tx_spec_t &spec, const char *ticker) {
+        bytes_t fees;
+        pb_bytes(fees, 2, address(1));
+        pb_bytes(fees, 3, coin(spec.feeWhole, spec.feeFrac, ticker));
+
+        bytes_t metadata;
+        pb_uint(metadata, 1, 1);
+
+        bytes_t sendmsg;
+        pb_bytes(sendmsg, 1, metadata);
+        pb_bytes(sendmsg, 2, address(2));
+        pb_bytes(sendmsg, 3, address(3));
+        pb_bytes(sendmsg, 4, coin(spec.amountWhole, spec.amountFrac, ticker));
+        if (!spec.memo.empty()) {
+            pb_string(sendmsg, 5, spec.memo);
+        }
+
+        bytes_t tx = {0x00, 0xCA, 0xFE, 0x00};
+        tx.push_back((uint8_t) spec.chainID.size());
+        tx.insert(tx.end(), spec.chainID.begin(), spec.chainID.end());
+        for (int i = 7; i >= 0; i--) {
+            tx.push_back((uint8_t) (spec.nonce >> (8u * i)));
+        }
+
+        pb_bytes(tx, 1, fees);
+        for (uint8_t i = 0; i < spec.multisigCount; i++) {
+            bytes_t contract(8);
+            for (uint8_t j = 0; j < 8; j++) {
+                contract[j] = (uint8_t) (i * 8 + j);
+            }
+            pb_bytes(tx, 4, contract);
+        }
+        pb_bytes(tx, 51, sendmsg);
+
+        return tx;
+    }
+
+    inline bytes_t build_tx(const tx_spec_t &spec) {
+        return build_tx(spec, "IOV");
+    }
+
+    struct corpus_entry_t {
+        const char *name;
+        bytes_t data;
+    };
+
+    // Transactions from the smallest to the largest the app accepts
+    inline std::vector<corpus_entry_t> build_corpus() {
+        const std::string memo128(TX_MEMOLEN_MAX, 'm');
+
+        std::vector<corpus_entry_t> corpus;
+        corpus.push_back({"small (no memo)",
+                          build_tx({"iov-lovenet", 1, 10, 0, 0, 10000000, "", 0})});
+        corpus.push_back({"typical (memo, 1 multisig)",
+                          build_tx({"iov-lovenet", 42, 1234, 500000000, 0, 10000000,
+                                    "payout #42", 1})});
+        corpus.push_back({"max multisig (no memo)",
+                          build_tx({"iov-lovenet", 7, 1, 0, 0, 10000000, "", PBIDX_MULTISIG_COUNT_MAX})});
+        corpus.push_back({"worst (128b memo, 8 multisig)",
+                          build_tx({"iov-lovenet", UINT64_MAX >> 1u, 999999999999999, 999999999,
+                                    999999999999999, 999999999, memo128, 8})});
+        return corpus;
+    }
+}
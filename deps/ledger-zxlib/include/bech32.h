@@ -27,6 +27,13 @@ void bech32EncodeFromBytes(char *output,
                            const uint8_t *data,
                            size_t data_len);
 
+#define BECH32_PAYLOAD20_LEN 20
+
+// same as bech32EncodeFromBytes for the common 20 byte payload (e.g. address hashes)
+void bech32EncodeFromBytes20(char *output,
+                             const char *hrp,
+                             const uint8_t *data);
+
 #ifdef __cplusplus
 }
 #endif
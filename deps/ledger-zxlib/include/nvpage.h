@@ -0,0 +1,69 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// Page-coalescing NVM writes
+// Writes are staged in a RAM copy of the flash page they target. A page is programmed once,
+// when it has been filled up or when nvpage_flush is called, instead of once per write.
+// Pages whose content already matches flash are not programmed at all.
+// Destinations must be in a page aligned area (see NV_ALIGN)
+
+// Size of the NVM pages programmed by nvm_write
+#if defined(TARGET_NANOX)
+#define NVPAGE_SIZE 512
+#else
+#define NVPAGE_SIZE 64
+#endif
+
+typedef struct {
+    uint32_t pagesWritten;      // pages programmed
+    uint32_t pagesSkipped;      // flushed pages that already matched flash
+    uint32_t bytesWritten;      // bytes programmed
+} nvpage_stats_t;
+
+/// Stage data for flash, the previous page is programmed when the write moves to another page
+/// \param dst flash address
+/// \param src
+/// \param length
+void nvpage_write(uint8_t *dst, const uint8_t *src, uint16_t length);
+
+/// Program the staged page, if any
+void nvpage_flush();
+
+/// Drop the staged page without programming it
+void nvpage_discard();
+
+/// Flash address of the page that is staged but not programmed yet
+/// \return NULL if everything has been programmed
+const uint8_t *nvpage_get_staged();
+
+/// Counters since the last nvpage_reset_stats
+/// \return
+const nvpage_stats_t *nvpage_get_stats();
+
+/// Reset counters
+void nvpage_reset_stats();
+
+#ifdef __cplusplus
+}
+#endif
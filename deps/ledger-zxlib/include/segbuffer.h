@@ -0,0 +1,70 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "buffering.h"
+
+// Scatter-gather buffer
+// Data fills the RAM segment first and continues in the flash segment.
+// Unlike buffering_append, data that is already in RAM is never copied to flash,
+// so only the overflow pays for NVM writes. Readers see RAM followed by flash.
+// Flash writes are coalesced by page (see nvpage.h), the last page is written by segbuffer_flush
+
+/// Initialize buffer
+/// \param ram_buffer
+/// \param ram_buffer_size
+/// \param flash_buffer
+/// \param flash_buffer_size
+void segbuffer_init(uint8_t *ram_buffer,
+                    uint16_t ram_buffer_size,
+                    uint8_t *flash_buffer,
+                    uint16_t flash_buffer_size);
+
+/// Reset buffer
+void segbuffer_reset();
+
+/// Append data to the buffer, the part that does not fit in RAM goes to flash
+/// \param data
+/// \param length
+/// \return the number of appended bytes, 0 if data does not fit in the remaining space
+int segbuffer_append(uint8_t *data, int length);
+
+/// Program data that is still staged for flash, call once the last chunk has been appended
+void segbuffer_flush();
+
+/// Total number of bytes in both segments
+uint16_t segbuffer_get_length();
+
+/// Number of bytes that can already be read back, data staged for flash is not included
+uint16_t segbuffer_get_readable_length();
+
+/// RAM segment, it always holds the beginning of the data
+/// \return
+buffer_state_t *segbuffer_get_ram_buffer();
+
+/// Flash segment, in use once RAM is full
+/// \return
+buffer_state_t *segbuffer_get_flash_buffer();
+
+#ifdef __cplusplus
+}
+#endif
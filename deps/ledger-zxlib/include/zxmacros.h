@@ -32,7 +32,8 @@ extern "C" {
 #define NV_VOL
 #endif
 
-#define NV_ALIGN __attribute__ ((aligned(64)))
+#include "nvpage.h"
+#define NV_ALIGN __attribute__ ((aligned(NVPAGE_SIZE)))
 
 #if defined (TARGET_NANOS) || defined(TARGET_NANOX)
 
@@ -63,6 +64,7 @@ extern "C" {
 #define MEMMOVE os_memmove
 #define MEMSET os_memset
 #define MEMCPY os_memcpy
+#define MEMCMP os_memcmp
 #define MEMCPY_NV nvm_write
 
 void debug_printf(void* buffer);
@@ -81,6 +83,7 @@ void __logstack();
 #define MEMMOVE memmove
 #define MEMSET memset
 #define MEMCPY memcpy
+#define MEMCMP memcmp
 #define MEMCPY_NV memcpy
 #define LOG(str)
 #define LOGSTACK()
@@ -236,6 +239,19 @@ size_t asciify(char *utf8_in);
 
 size_t asciify_ext(const char *utf8_in, char *ascii_only_out);
 
+/// Replace non printable and non ASCII characters by '.' in a single pass
+/// \param utf8_in stops at inLen or at the first zero, whichever comes first
+/// \param inLen
+/// \param ascii_only_out can be utf8_in, at least inLen + 1 bytes
+/// \return length of the output, 0 if the input is not valid UTF-8
+size_t asciify_n(const char *utf8_in, size_t inLen, char *ascii_only_out);
+
+/// Length asciify_n would output, without writing anything
+/// \param utf8_in
+/// \param inLen
+/// \return
+size_t asciify_n_len(const char *utf8_in, size_t inLen);
+
 #ifndef PIC
 #define PIC(x) (x)
 #endif
@@ -17,9 +17,74 @@
 #include <stdint.h>
 #include <stddef.h>
 #include "bech32.h"
-#include "segwit_addr.h"
-#include "bittools.h"
+#include "zxmacros.h"
 
+static const char bech32_charset[] = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
+
+// Generators selected by the 5 bits that are shifted out of the checksum (see bech32_polymod_step)
+static const uint32_t bech32_polymod_table[32] = {
+        0x00000000u, 0x3b6a57b2u, 0x26508e6du, 0x1d3ad9dfu,
+        0x1ea119fau, 0x25cb4e48u, 0x38f19797u, 0x039bc025u,
+        0x3d4233ddu, 0x0628646fu, 0x1b12bdb0u, 0x2078ea02u,
+        0x23e32a27u, 0x18897d95u, 0x05b3a44au, 0x3ed9f3f8u,
+        0x2a1462b3u, 0x117e3501u, 0x0c44ecdeu, 0x372ebb6cu,
+        0x34b57b49u, 0x0fdf2cfbu, 0x12e5f524u, 0x298fa296u,
+        0x1756516eu, 0x2c3c06dcu, 0x3106df03u, 0x0a6c88b1u,
+        0x09f74894u, 0x329d1f26u, 0x2fa7c6f9u, 0x14cd914bu,
+};
+
+__Z_INLINE uint32_t bech32_polymod(uint32_t chk, uint8_t value) {
+    return (((chk & 0x1FFFFFFu) << 5u) ^ bech32_polymod_table[chk >> 25u]) ^ value;
+}
+
+// Writes the hrp and the separator, returns where values go or NULL if the hrp is invalid or too long
+__Z_INLINE char *bech32_encodeHrp(char *output, const char *hrp, size_t values_len, uint32_t *chk) {
+    output[0] = 0;
+
+    *chk = 1;
+    size_t hrp_len = 0;
+    while (hrp[hrp_len] != 0) {
+        const char ch = hrp[hrp_len];
+        if (ch < 33 || ch > 126 || (ch >= 'A' && ch <= 'Z')) {
+            return NULL;
+        }
+        *chk = bech32_polymod(*chk, ch >> 5u);
+        hrp_len++;
+    }
+
+    if (hrp_len + 7 + values_len > 90) {
+        return NULL;
+    }
+
+    *chk = bech32_polymod(*chk, 0);
+    for (size_t i = 0; i < hrp_len; i++) {
+        *chk = bech32_polymod(*chk, hrp[i] & 0x1Fu);
+        output[i] = hrp[i];
+    }
+
+    output[hrp_len] = '1';
+    return output + hrp_len + 1;
+}
+
+#define BECH32_PUT(VALUE) { \
+    const uint8_t v = (VALUE); \
+    chk = bech32_polymod(chk, v); \
+    *(out++) = bech32_charset[v]; \
+}
+
+__Z_INLINE void bech32_encodeChecksum(char *out, uint32_t chk) {
+    for (uint8_t i = 0; i < 6; i++) {
+        chk = bech32_polymod(chk, 0);
+    }
+    chk ^= 1;
+    for (uint8_t i = 0; i < 6; i++) {
+        *(out++) = bech32_charset[(chk >> ((5u - i) * 5u)) & 0x1Fu];
+    }
+    *out = 0;
+}
+
+// Converts to 5 bit values, computes the checksum and writes characters in a single pass
+// Same output as convert_bits (no padding) followed by bech32_encode
 void bech32EncodeFromBytes(char *output,
                            const char *hrp,
                            const uint8_t *data,
@@ -29,9 +94,47 @@ void bech32EncodeFromBytes(char *output,
         return;
     }
 
-    uint8_t tmp_data[128];
-    size_t tmp_size = 0;
+    // Bits that do not fill a last 5 bit value are dropped
+    uint32_t chk;
+    char *out = bech32_encodeHrp(output, hrp, data_len * 8 / 5, &chk);
+    if (out == NULL) {
+        return;
+    }
+
+    uint32_t acc = 0;
+    uint8_t bits = 0;
+    for (size_t i = 0; i < data_len; i++) {
+        acc = (acc << 8u) | data[i];
+        bits += 8;
+        while (bits >= 5) {
+            bits -= 5;
+            BECH32_PUT((acc >> bits) & 0x1Fu)
+        }
+    }
+
+    bech32_encodeChecksum(out, chk);
+}
+
+void bech32EncodeFromBytes20(char *output,
+                             const char *hrp,
+                             const uint8_t *data) {
+    uint32_t chk;
+    char *out = bech32_encodeHrp(output, hrp, BECH32_PAYLOAD20_LEN * 8 / 5, &chk);
+    if (out == NULL) {
+        return;
+    }
+
+    // Every 5 bytes give exactly 8 values, no bits are carried between groups
+    for (const uint8_t *b = data; b < data + BECH32_PAYLOAD20_LEN; b += 5) {
+        BECH32_PUT(b[0] >> 3u)
+        BECH32_PUT(((b[0] & 0x07u) << 2u) | (b[1] >> 6u))
+        BECH32_PUT((b[1] >> 1u) & 0x1Fu)
+        BECH32_PUT(((b[1] & 0x01u) << 4u) | (b[2] >> 4u))
+        BECH32_PUT(((b[2] & 0x0Fu) << 1u) | (b[3] >> 7u))
+        BECH32_PUT((b[3] >> 2u) & 0x1Fu)
+        BECH32_PUT(((b[3] & 0x03u) << 3u) | (b[4] >> 5u))
+        BECH32_PUT(b[4] & 0x1Fu)
+    }
 
-    convert_bits(tmp_data, &tmp_size, 5, data, data_len, 8, 0);
-    bech32_encode(output, hrp, tmp_data, tmp_size);
+    bech32_encodeChecksum(out, chk);
 }
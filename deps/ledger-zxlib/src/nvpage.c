@@ -0,0 +1,96 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "nvpage.h"
+#include <zxmacros.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// zxlib has no access to the app arena; staging is flushed before the tx is parsed
+uint8_t nvpage_ram[NVPAGE_SIZE];        // content of the staged page
+uint8_t *nvpage_staged;                 // flash address of the staged page, NULL if none
+nvpage_stats_t nvpage_stats;
+
+__Z_INLINE uint8_t *nvpage_start(uint8_t *p) {
+    return (uint8_t *) ((uintptr_t) p & ~((uintptr_t) NVPAGE_SIZE - 1));
+}
+
+void nvpage_write(uint8_t *dst, const uint8_t *src, uint16_t length) {
+    while (length > 0) {
+        uint8_t *page = nvpage_start(dst);
+        if (page != nvpage_staged) {
+            nvpage_flush();
+            // Bytes that are not written keep their current value
+            MEMCPY(nvpage_ram, page, NVPAGE_SIZE);
+            nvpage_staged = page;
+        }
+
+        const uint16_t pageOffset = dst - page;
+        uint16_t count = NVPAGE_SIZE - pageOffset;
+        if (count > length) {
+            count = length;
+        }
+
+        MEMCPY(nvpage_ram + pageOffset, src, count);
+        dst += count;
+        src += count;
+        length -= count;
+
+        if (pageOffset + count == NVPAGE_SIZE) {
+            // Appends do not come back to a page once it is full
+            nvpage_flush();
+        }
+    }
+}
+
+void nvpage_flush() {
+    if (nvpage_staged == NULL) {
+        return;
+    }
+
+    if (MEMCMP(nvpage_staged, nvpage_ram, NVPAGE_SIZE) == 0) {
+        // e.g. the same transaction is sent again
+        nvpage_stats.pagesSkipped++;
+    } else {
+        MEMCPY_NV(nvpage_staged, nvpage_ram, NVPAGE_SIZE);
+        nvpage_stats.pagesWritten++;
+        nvpage_stats.bytesWritten += NVPAGE_SIZE;
+    }
+
+    nvpage_staged = NULL;
+}
+
+void nvpage_discard() {
+    nvpage_staged = NULL;
+}
+
+const uint8_t *nvpage_get_staged() {
+    return nvpage_staged;
+}
+
+const nvpage_stats_t *nvpage_get_stats() {
+    return &nvpage_stats;
+}
+
+void nvpage_reset_stats() {
+    MEMSET(&nvpage_stats, 0, sizeof(nvpage_stats));
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,107 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "segbuffer.h"
+#include "nvpage.h"
+#include <zxmacros.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+buffer_state_t seg_ram;         // Ram
+buffer_state_t seg_flash;       // Flash
+
+void segbuffer_init(uint8_t *ram_buffer,
+                    uint16_t ram_buffer_size,
+                    uint8_t *flash_buffer,
+                    uint16_t flash_buffer_size) {
+    seg_ram.data = ram_buffer;
+    seg_ram.size = ram_buffer_size;
+
+    seg_flash.data = flash_buffer;
+    seg_flash.size = flash_buffer_size;
+
+    segbuffer_reset();
+}
+
+void segbuffer_reset() {
+    seg_ram.pos = 0;
+    seg_ram.in_use = 1;
+    seg_flash.pos = 0;
+    seg_flash.in_use = 0;
+    // Anything staged by a previous transfer is stale
+    nvpage_discard();
+}
+
+int segbuffer_append(uint8_t *data, int length) {
+    if (length < 0) {
+        return 0;
+    }
+
+    const int ramFree = seg_ram.size - seg_ram.pos;
+    const int flashFree = seg_flash.size - seg_flash.pos;
+    if (length > ramFree + flashFree) {
+        return 0;
+    }
+
+    // Fill RAM, then continue in flash
+    const int toRam = length < ramFree ? length : ramFree;
+    if (toRam > 0) {
+        MEMCPY(seg_ram.data + seg_ram.pos, data, toRam);
+        seg_ram.pos += toRam;
+    }
+
+    const int toFlash = length - toRam;
+    if (toFlash > 0) {
+        nvpage_write(seg_flash.data + seg_flash.pos, data + toRam, toFlash);
+        seg_flash.pos += toFlash;
+        seg_flash.in_use = 1;
+    }
+
+    return length;
+}
+
+void segbuffer_flush() {
+    nvpage_flush();
+}
+
+uint16_t segbuffer_get_length() {
+    return seg_ram.pos + seg_flash.pos;
+}
+
+uint16_t segbuffer_get_readable_length() {
+    const uint8_t *staged = nvpage_get_staged();
+    if (staged == NULL || staged >= seg_flash.data + seg_flash.pos) {
+        return segbuffer_get_length();
+    }
+    if (staged <= seg_flash.data) {
+        return seg_ram.pos;
+    }
+    return seg_ram.pos + (staged - seg_flash.data);
+}
+
+buffer_state_t *segbuffer_get_ram_buffer() {
+    return &seg_ram;
+}
+
+buffer_state_t *segbuffer_get_flash_buffer() {
+    return &seg_flash;
+}
+
+#ifdef __cplusplus
+}
+#endif
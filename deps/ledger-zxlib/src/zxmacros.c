@@ -40,18 +40,98 @@ size_t asciify(char *utf8_in_ascii_out)
 }
 
 size_t asciify_ext(const char *utf8_in, char *ascii_only_out) {
-    void *p = (void *) utf8_in;
-    char *q = ascii_only_out;
-
-    // utf8valid returns zero on success
-    while (*((char *) p) && utf8valid(p) == 0) {
-        utf8_int32_t tmp_codepoint = 0;
-        p = utf8codepoint(p, &tmp_codepoint);
-        *q = (tmp_codepoint >= 32 && tmp_codepoint <= 0x7F)? tmp_codepoint : '.';
-        q++;
+    return asciify_n(utf8_in, strlen(utf8_in), ascii_only_out);
+}
+
+#define ASCIIFY_ONES    0x0101010101010101u
+
+// Shared by asciify_n and asciify_n_len, write is a constant so each caller gets its own loop
+__Z_INLINE size_t asciify_run(const char *utf8_in, size_t inLen, char *ascii_only_out, const uint8_t write) {
+    const uint8_t *p = (const uint8_t *) utf8_in;
+    const uint8_t *end = p + inLen;
+    size_t outLen = 0;
+
+    while (p < end) {
+        // Pure ASCII fast path: 8 characters in [32, 127] are copied as they are
+        // memcpy with a constant size compiles to plain loads and stores, out is never ahead of in
+        if (end - p >= 8) {
+            uint64_t w;
+            memcpy(&w, p, sizeof(w));
+            if ((((w - 0x20u * ASCIIFY_ONES) | w) & (0x80u * ASCIIFY_ONES)) == 0) {
+                if (write) {
+                    memcpy(ascii_only_out + outLen, &w, sizeof(w));
+                }
+                p += sizeof(w);
+                outLen += sizeof(w);
+                continue;
+            }
+        }
+
+        const uint8_t c = *p;
+        if (c == 0) {
+            break;
+        }
+        if (c < 0x80) {
+            if (write) {
+                ascii_only_out[outLen] = c >= 32 ? (char) c : '.';
+            }
+            outLen++;
+            p++;
+            continue;
+        }
+
+        // Multi-byte codepoints are validated here and shown as a single '.'
+        // Same rules as utf8valid: no stray continuation bytes, no truncated or overlong sequences
+        uint8_t n;
+        if ((c & 0xE0u) == 0xC0u) {
+            n = 2;
+        } else if ((c & 0xF0u) == 0xE0u) {
+            n = 3;
+        } else if ((c & 0xF8u) == 0xF0u) {
+            n = 4;
+        } else {
+            break;
+        }
+        if (end - p < n) {
+            break;
+        }
+        uint8_t i = 1;
+        while (i < n && (p[i] & 0xC0u) == 0x80u) {
+            i++;
+        }
+        if (i < n) {
+            break;
+        }
+        // Overlong, a shorter sequence could have been used
+        if ((n == 2 && (c & 0x1Eu) == 0) ||
+            (n == 3 && (c & 0x0Fu) == 0 && (p[1] & 0x20u) == 0) ||
+            (n == 4 && (c & 0x07u) == 0 && (p[1] & 0x30u) == 0)) {
+            break;
+        }
+
+        if (write) {
+            ascii_only_out[outLen] = '.';
+        }
+        outLen++;
+        p += n;
     }
 
-    // Terminate string
-    *q = 0;
-    return q - ascii_only_out;
+    if (p < end && *p != 0) {
+        // Strings that are not valid UTF-8 are not shown at all
+        outLen = 0;
+    }
+
+    if (write) {
+        // Terminate string
+        ascii_only_out[outLen] = 0;
+    }
+    return outLen;
+}
+
+size_t asciify_n(const char *utf8_in, size_t inLen, char *ascii_only_out) {
+    return asciify_run(utf8_in, inLen, ascii_only_out, 1);
+}
+
+size_t asciify_n_len(const char *utf8_in, size_t inLen) {
+    return asciify_run(utf8_in, inLen, NULL, 0);
 }
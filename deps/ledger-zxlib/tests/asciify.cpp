@@ -15,8 +15,35 @@
 ********************************************************************************/
 #include <gmock/gmock.h>
 #include <zxmacros.h>
+#include <utf8.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
 
 namespace {
+    // Per codepoint loop that revalidated the remaining string every time, kept as a reference
+    size_t referenceAsciify(const char *utf8_in, char *ascii_only_out) {
+        void *p = (void *) utf8_in;
+        char *q = ascii_only_out;
+        while (*((char *) p) && utf8valid(p) == 0) {
+            utf8_int32_t tmp_codepoint = 0;
+            p = utf8codepoint(p, &tmp_codepoint);
+            *q = (tmp_codepoint >= 32 && tmp_codepoint <= 0x7F) ? tmp_codepoint : '.';
+            q++;
+        }
+        *q = 0;
+        return q - ascii_only_out;
+    }
+
+    void expectSameAsReference(const std::string &input) {
+        std::vector<char> want(input.size() + 1), have(input.size() + 1);
+        const size_t wantLen = referenceAsciify(input.c_str(), want.data());
+        const size_t haveLen = asciify_n(input.data(), input.size(), have.data());
+        ASSERT_EQ(wantLen, haveLen) << "input of " << input.size() << " bytes";
+        ASSERT_EQ(wantLen, asciify_n_len(input.data(), input.size())) << "input of " << input.size() << " bytes";
+        ASSERT_STREQ(want.data(), have.data());
+    }
     TEST(ASCIIFY, pure) {
         char input[] = "This is only ascii";
         char *want = input;
@@ -116,4 +143,103 @@ namespace {
         EXPECT_STREQ(want, data);
     }
 
+    TEST(ASCIIFY, invalid_utf8) {
+        char have[50];
+        // stray continuation, truncated sequence, overlong encoding
+        EXPECT_EQ(0, asciify_ext("abc\x80" "def", have));
+        EXPECT_STREQ("", have);
+        EXPECT_EQ(0, asciify_ext("abc\xE5\x93", have));
+        EXPECT_STREQ("", have);
+        EXPECT_EQ(0, asciify_ext("\xC0\xAF" "abc", have));
+        EXPECT_STREQ("", have);
+    }
+
+    TEST(ASCIIFY, length_limited) {
+        const char input[] = "Something\0hidden";
+        char have[50];
+
+        EXPECT_EQ(4, asciify_n(input, 4, have));
+        EXPECT_STREQ("Some", have);
+        // Stops at the first zero
+        EXPECT_EQ(9, asciify_n(input, sizeof(input) - 1, have));
+        EXPECT_STREQ("Something", have);
+    }
+
+    TEST(ASCIIFY, length_only) {
+        EXPECT_EQ(5, asciify_n_len("\05test", 5));
+        EXPECT_EQ(3, asciify_n_len("a\xC3\xB1" "b", 4)) << "A codepoint is one character";
+        EXPECT_EQ(0, asciify_n_len("abc\x80" "def", 7)) << "Invalid UTF-8 is not shown";
+        EXPECT_EQ(9, asciify_n_len("Something\0hidden", 16)) << "Stops at the first zero";
+    }
+
+    TEST(ASCIIFY, matches_reference_short) {
+        // Every string of up to 4 bytes built from lead, continuation and ASCII boundary values
+        const uint8_t alphabet[] = {0x00, 0x05, 0x20, 'a', 0x7F, 0x80, 0x8F, 0x90, 0x9F, 0xA0, 0xBF,
+                                    0xC0, 0xC1, 0xC2, 0xDF, 0xE0, 0xED, 0xEF, 0xF0, 0xF4, 0xF7, 0xF8, 0xFF};
+        const size_t n = sizeof(alphabet);
+        for (size_t len = 1; len <= 4; len++) {
+            size_t count = 1;
+            for (size_t i = 0; i < len; i++) {
+                count *= n;
+            }
+            for (size_t k = 0; k < count; k++) {
+                std::string input;
+                for (size_t i = 0, v = k; i < len; i++, v /= n) {
+                    input.push_back((char) alphabet[v % n]);
+                }
+                expectSameAsReference(input);
+            }
+        }
+    }
+
+    TEST(ASCIIFY, matches_reference_long) {
+        // ASCII runs of every length around the 8 byte fast path, mixed with UTF-8 and invalid bytes
+        const char *pieces[] = {"\x01", "\x7F", "\xC3\xB1", "\xE5\x93\x88", "\xF0\x9F\x98\x80", "\xFF"};
+        std::mt19937 rng(42);
+        for (int round = 0; round < 2000; round++) {
+            std::string input;
+            while (input.size() < 300) {
+                input.append(rng() % 20, (char) ('a' + rng() % 26));
+                const uint32_t piece = rng() % 64;
+                if (piece < 6 && (piece != 5 || round % 4 == 0)) {
+                    input.append(pieces[piece]);
+                }
+            }
+            expectSameAsReference(input);
+        }
+    }
+
+    TEST(ASCIIFY, benchmark) {
+        // Memos are up to 128 bytes, longer inputs show how both versions scale
+        for (size_t len : {16, 64, 128, 512, 2048}) {
+            for (bool pure : {true, false}) {
+                std::string input;
+                while (input.size() < len) {
+                    input.append(pure ? "payout #" : "pay\xC3\xB1");
+                }
+                input.resize(len);
+                if (!pure) {
+                    // do not end on a truncated sequence
+                    while ((input.back() & 0x80) != 0) {
+                        input.back() = 'x';
+                    }
+                }
+                std::vector<char> out(len + 1);
+                const int iterations = 200000 / len;
+
+                auto measure = [&](size_t (*fn)(const char *, char *)) {
+                    const auto start = std::chrono::steady_clock::now();
+                    for (int i = 0; i < iterations; i++) {
+                        fn(input.c_str(), out.data());
+                    }
+                    const auto end = std::chrono::steady_clock::now();
+                    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+                };
+
+                std::cout << "  " << len << (pure ? " ascii " : " utf8  ")
+                          << "reference: " << measure(referenceAsciify) << " ns, "
+                          << "asciify_ext: " << measure(asciify_ext) << " ns" << std::endl;
+            }
+        }
+    }
 }
@@ -16,8 +16,28 @@
 #include <gmock/gmock.h>
 #include <zxmacros.h>
 #include <bech32.h>
+#include <bittools.h>
+#include <chrono>
+
+extern "C" {
+#include <segwit_addr.h>
+}
 
 namespace {
+    // Two pass encoding: 8 to 5 bits conversion into a temporary buffer, then bech32_encode
+    void referenceEncode(char *output, const char *hrp, const uint8_t *data, size_t data_len) {
+        output[0] = 0;
+        if (data_len > 128) {
+            return;
+        }
+
+        uint8_t tmp_data[128];
+        size_t tmp_size = 0;
+
+        convert_bits(tmp_data, &tmp_size, 5, data, data_len, 8, 0);
+        bech32_encode(output, hrp, tmp_data, tmp_size);
+    }
+
     TEST(BECH32, hex_to_address) {
         char addr_out[100];
         const char *hrp = "zx";
@@ -33,4 +53,72 @@ namespace {
         std::cout << addr_out << std::endl;
         ASSERT_STREQ("zx1qyps2pcfpvx20dk22", addr_out);
     }
+
+    TEST(BECH32, matches_two_pass_encoding) {
+        const char *hrps[] = {"iov", "tiov", "zx", "a", "IOV", "i v", ""};
+        uint8_t data[80];
+        uint32_t seed = 1;
+
+        for (const char *hrp : hrps) {
+            for (size_t len = 0; len <= sizeof(data); len++) {
+                for (size_t i = 0; i < len; i++) {
+                    seed = seed * 1103515245u + 12345u;
+                    data[i] = seed >> 16u;
+                }
+
+                char expected[200];
+                char addr_out[200];
+                referenceEncode(expected, hrp, data, len);
+                bech32EncodeFromBytes(addr_out, hrp, data, len);
+                ASSERT_STREQ(expected, addr_out) << "hrp '" << hrp << "', " << len << " bytes";
+            }
+        }
+    }
+
+    TEST(BECH32, payload20) {
+        uint8_t data[BECH32_PAYLOAD20_LEN];
+        for (uint8_t i = 0; i < sizeof(data); i++) {
+            data[i] = 0xA5u ^ (i * 37u);
+        }
+
+        for (const char *hrp : {"iov", "tiov", "IOV"}) {
+            char expected[100];
+            char addr_out[100];
+            bech32EncodeFromBytes(expected, hrp, data, sizeof(data));
+            bech32EncodeFromBytes20(addr_out, hrp, data);
+            ASSERT_STREQ(expected, addr_out) << "hrp " << hrp;
+        }
+    }
+
+    // Not a check, prints the cost of encoding an address with each implementation
+    TEST(BECH32, benchmark) {
+        const int iterations = 20000;
+        uint8_t data[BECH32_PAYLOAD20_LEN] = {};
+        char addr_out[100];
+        uint32_t sink = 0;
+
+        auto measure = [&](const char *name, void (*encode)(char *, const uint8_t *)) {
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; i++) {
+                data[i % sizeof(data)] = i;
+                encode(addr_out, data);
+                sink += addr_out[10];
+            }
+            const auto end = std::chrono::steady_clock::now();
+            const double ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+            std::cout << "  " << name << ": " << ns << " ns" << std::endl;
+        };
+
+        measure("convert_bits + bech32_encode", [](char *out, const uint8_t *d) {
+            referenceEncode(out, "iov", d, BECH32_PAYLOAD20_LEN);
+        });
+        measure("bech32EncodeFromBytes       ", [](char *out, const uint8_t *d) {
+            bech32EncodeFromBytes(out, "iov", d, BECH32_PAYLOAD20_LEN);
+        });
+        measure("bech32EncodeFromBytes20     ", [](char *out, const uint8_t *d) {
+            bech32EncodeFromBytes20(out, "iov", d);
+        });
+
+        EXPECT_NE(0u, sink);
+    }
 }
@@ -0,0 +1,109 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#include "gtest/gtest.h"
+#include "nvpage.h"
+
+namespace {
+
+    TEST(NVPage, CoalesceSmallWrites) {
+        alignas(NVPAGE_SIZE) uint8_t flash[4 * NVPAGE_SIZE] = {};
+        nvpage_discard();
+        nvpage_reset_stats();
+
+        // 13 byte chunks straddle page boundaries, each page is still written once
+        uint8_t chunk[13];
+        for (size_t i = 0; i < sizeof(chunk); i++) {
+            chunk[i] = 0x10 + i;
+        }
+        for (int offset = 0; offset + sizeof(chunk) <= sizeof(flash); offset += sizeof(chunk)) {
+            nvpage_write(flash + offset, chunk, sizeof(chunk));
+        }
+        nvpage_flush();
+
+        EXPECT_EQ(4, nvpage_get_stats()->pagesWritten) << "Each page should be written once";
+        EXPECT_EQ(4 * NVPAGE_SIZE, nvpage_get_stats()->bytesWritten) << "Wrong number of bytes written";
+        EXPECT_EQ(nullptr, nvpage_get_staged()) << "Nothing should be staged after flush";
+
+        for (size_t i = 0; i < sizeof(flash) / sizeof(chunk) * sizeof(chunk); i++) {
+            EXPECT_EQ(0x10 + i % sizeof(chunk), flash[i]) << "Wrong data at " << i;
+        }
+    }
+
+    TEST(NVPage, StagedUntilFull) {
+        alignas(NVPAGE_SIZE) uint8_t flash[2 * NVPAGE_SIZE] = {};
+        nvpage_discard();
+        nvpage_reset_stats();
+
+        uint8_t data[NVPAGE_SIZE + 1];
+        memset(data, 0xAA, sizeof(data));
+
+        nvpage_write(flash, data, NVPAGE_SIZE - 1);
+        EXPECT_EQ(flash, nvpage_get_staged()) << "Incomplete page should be staged";
+        EXPECT_EQ(0, flash[0]) << "Staged data should not be in flash yet";
+
+        nvpage_write(flash + NVPAGE_SIZE - 1, data, 2);
+        EXPECT_EQ(1, nvpage_get_stats()->pagesWritten) << "Complete page should be written";
+        EXPECT_EQ(0xAA, flash[NVPAGE_SIZE - 1]) << "Complete page should be in flash";
+        EXPECT_EQ(flash + NVPAGE_SIZE, nvpage_get_staged()) << "Next page should be staged";
+
+        nvpage_discard();
+        EXPECT_EQ(0, flash[NVPAGE_SIZE]) << "Discarded data should not be written";
+        EXPECT_EQ(1, nvpage_get_stats()->pagesWritten) << "Discard should not write";
+    }
+
+    TEST(NVPage, PartialPageKeepsContent) {
+        alignas(NVPAGE_SIZE) uint8_t flash[NVPAGE_SIZE];
+        memset(flash, 0x55, sizeof(flash));
+        nvpage_discard();
+
+        uint8_t data[4] = {1, 2, 3, 4};
+        nvpage_write(flash + 10, data, sizeof(data));
+        nvpage_flush();
+
+        for (size_t i = 0; i < sizeof(flash); i++) {
+            const uint8_t expected = i >= 10 && i < 14 ? data[i - 10] : 0x55;
+            EXPECT_EQ(expected, flash[i]) << "Wrong data at " << i;
+        }
+    }
+
+    TEST(NVPage, SkipUnchanged) {
+        alignas(NVPAGE_SIZE) uint8_t flash[3 * NVPAGE_SIZE] = {};
+        nvpage_discard();
+
+        uint8_t data[2 * NVPAGE_SIZE + 20];
+        for (size_t i = 0; i < sizeof(data); i++) {
+            data[i] = i;
+        }
+        nvpage_write(flash, data, sizeof(data));
+        nvpage_flush();
+
+        // The same content again
+        nvpage_reset_stats();
+        nvpage_write(flash, data, sizeof(data));
+        nvpage_flush();
+        EXPECT_EQ(0, nvpage_get_stats()->pagesWritten) << "Unchanged pages should not be written";
+        EXPECT_EQ(3, nvpage_get_stats()->pagesSkipped) << "Wrong number of skipped pages";
+
+        // Only the page that changed is written
+        nvpage_reset_stats();
+        data[NVPAGE_SIZE + 1] = 0xFF;
+        nvpage_write(flash, data, sizeof(data));
+        nvpage_flush();
+        EXPECT_EQ(1, nvpage_get_stats()->pagesWritten) << "Only the modified page should be written";
+        EXPECT_EQ(2, nvpage_get_stats()->pagesSkipped) << "Wrong number of skipped pages";
+        EXPECT_EQ(0xFF, flash[NVPAGE_SIZE + 1]) << "Modified data should be in flash";
+    }
+}
@@ -0,0 +1,170 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#include "gtest/gtest.h"
+#include "segbuffer.h"
+#include "nvpage.h"
+
+namespace {
+
+    TEST(SegBuffer, SmallBuffer) {
+
+        uint8_t ram_buffer[100];
+        alignas(NVPAGE_SIZE) uint8_t flash_buffer[1024];
+
+        segbuffer_init(ram_buffer,
+                       sizeof(ram_buffer),
+                       flash_buffer,
+                       sizeof(flash_buffer));
+
+        // Data is small enough to fit into ram buffer
+        uint8_t small[50];
+        auto num_bytes = segbuffer_append(small, sizeof(small));
+        EXPECT_EQ(sizeof(small), num_bytes) << "Append should not return error";
+
+        EXPECT_FALSE(segbuffer_get_flash_buffer()->in_use) << "Writing small buffer should only write to RAM";
+        EXPECT_EQ(50, segbuffer_get_ram_buffer()->pos) << "Wrong position of the written data in the ram buffer";
+        EXPECT_EQ(0, segbuffer_get_flash_buffer()->pos) << "Wrong position of the written data in the flash buffer";
+        EXPECT_EQ(50, segbuffer_get_length()) << "Wrong length";
+    }
+
+    TEST(SegBuffer, OverflowKeepsRamInPlace) {
+
+        uint8_t ram_buffer[100];
+        alignas(NVPAGE_SIZE) uint8_t flash_buffer[1024];
+
+        segbuffer_init(ram_buffer,
+                       sizeof(ram_buffer),
+                       flash_buffer,
+                       sizeof(flash_buffer));
+
+        uint8_t small1[80];
+        for (size_t i = 0; i < sizeof(small1); i++) {
+            small1[i] = i;
+        }
+        segbuffer_append(small1, sizeof(small1));
+
+        // Only the part that does not fit in RAM is written to flash
+        uint8_t small2[50];
+        for (size_t i = 0; i < sizeof(small2); i++) {
+            small2[i] = 200 - i;
+        }
+        auto num_bytes = segbuffer_append(small2, sizeof(small2));
+        EXPECT_EQ(sizeof(small2), num_bytes) << "Append should not return error";
+
+        EXPECT_TRUE(segbuffer_get_flash_buffer()->in_use) << "Overflow should be written to FLASH";
+        EXPECT_EQ(100, segbuffer_get_ram_buffer()->pos) << "RAM should be filled up";
+        EXPECT_EQ(30, segbuffer_get_flash_buffer()->pos) << "Only the overflow should be written to FLASH";
+        EXPECT_EQ(130, segbuffer_get_length()) << "Wrong length";
+
+        // The last flash page is only written on flush
+        EXPECT_EQ(100, segbuffer_get_readable_length()) << "Staged data should not be readable";
+        segbuffer_flush();
+        EXPECT_EQ(130, segbuffer_get_readable_length()) << "Flushed data should be readable";
+
+        // RAM followed by flash gives back the appended data
+        for (size_t i = 0; i < sizeof(small1) + sizeof(small2); i++) {
+            const uint8_t got = i < 100 ? ram_buffer[i] : flash_buffer[i - 100];
+            const uint8_t expected = i < sizeof(small1) ? small1[i] : small2[i - sizeof(small1)];
+            EXPECT_EQ(expected, got) << "Wrong data at " << i;
+        }
+    }
+
+    TEST(SegBuffer, BigBuffer) {
+
+        uint8_t ram_buffer[100];
+        alignas(NVPAGE_SIZE) uint8_t flash_buffer[1024];
+
+        segbuffer_init(ram_buffer,
+                       sizeof(ram_buffer),
+                       flash_buffer,
+                       sizeof(flash_buffer));
+
+        // A single append can span both segments
+        uint8_t big[500];
+        auto num_bytes = segbuffer_append(big, sizeof(big));
+        EXPECT_EQ(sizeof(big), num_bytes) << "Append should not return error";
+
+        EXPECT_EQ(100, segbuffer_get_ram_buffer()->pos) << "RAM should be filled up";
+        EXPECT_EQ(400, segbuffer_get_flash_buffer()->pos) << "Wrong position of the written data in the flash buffer";
+    }
+
+    TEST(SegBuffer, NotEnoughRoom) {
+
+        uint8_t ram_buffer[100];
+        alignas(NVPAGE_SIZE) uint8_t flash_buffer[1024];
+
+        segbuffer_init(ram_buffer,
+                       sizeof(ram_buffer),
+                       flash_buffer,
+                       sizeof(flash_buffer));
+
+        uint8_t big[1124];
+        EXPECT_EQ(sizeof(big), segbuffer_append(big, sizeof(big))) << "Both segments together should be usable";
+
+        uint8_t one[1];
+        EXPECT_EQ(0, segbuffer_append(one, sizeof(one))) << "Appending outside the bounds of the buffer should return error";
+        EXPECT_EQ(1124, segbuffer_get_length()) << "Failed append should not change the buffer";
+    }
+
+    TEST(SegBuffer, ReadableByPage) {
+
+        uint8_t ram_buffer[100];
+        alignas(NVPAGE_SIZE) uint8_t flash_buffer[1024];
+
+        segbuffer_init(ram_buffer,
+                       sizeof(ram_buffer),
+                       flash_buffer,
+                       sizeof(flash_buffer));
+
+        // Full flash pages are written as soon as they are complete
+        uint8_t data[100 + 2 * NVPAGE_SIZE + 10] = {};
+        segbuffer_append(data, sizeof(data));
+        EXPECT_EQ(100 + 2 * NVPAGE_SIZE, segbuffer_get_readable_length()) << "Complete pages should be readable";
+
+        segbuffer_flush();
+        EXPECT_EQ(sizeof(data), segbuffer_get_readable_length()) << "Everything should be readable after flush";
+    }
+
+    TEST(SegBuffer, NoFlash) {
+        uint8_t ram_buffer[100];
+
+        segbuffer_init(ram_buffer,
+                       sizeof(ram_buffer),
+                       nullptr, 0);
+
+        uint8_t small[60];
+        EXPECT_EQ(60, segbuffer_append(small, sizeof(small))) << "Could not add to RAM";
+        EXPECT_EQ(0, segbuffer_append(small, sizeof(small))) << "Could add to RAM when it should have been impossible";
+    }
+
+    TEST(SegBuffer, Reset) {
+
+        uint8_t ram_buffer[100];
+        alignas(NVPAGE_SIZE) uint8_t flash_buffer[1024];
+
+        segbuffer_init(ram_buffer,
+                       sizeof(ram_buffer),
+                       flash_buffer,
+                       sizeof(flash_buffer));
+
+        uint8_t big[300];
+        segbuffer_append(big, sizeof(big));
+        segbuffer_reset();
+
+        EXPECT_FALSE(segbuffer_get_flash_buffer()->in_use) << "After reset only RAM should be in use";
+        EXPECT_EQ(0, segbuffer_get_length()) << "After reset the buffer should be empty";
+    }
+}
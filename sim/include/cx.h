@@ -0,0 +1,87 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+
+// Minimal replacement of the BOLOS cx.h used by the APDU simulator
+// Outputs are deterministic but they are NOT real hashes, keys or signatures
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CX_CURVE_Ed25519    0x41
+
+#define CX_LAST             (1 << 0)
+#define CX_SHA256           3
+#define CX_SHA512           5
+
+#define CX_SHA256_SIZE      32
+#define CX_SHA512_SIZE      64
+
+typedef struct {
+    unsigned int curve;
+    unsigned int d_len;
+    unsigned char d[32];
+} cx_ecfp_private_key_t;
+
+typedef struct {
+    unsigned int curve;
+    unsigned int W_len;
+    unsigned char W[65];
+} cx_ecfp_public_key_t;
+
+typedef struct {
+    int algo;
+    unsigned int counter;
+} cx_hash_t;
+
+// Same size and layout as the SDK, so buffers overlaid with it behave as on the device
+typedef struct {
+    cx_hash_t header;
+    unsigned int blen;
+    unsigned char block[256];
+    unsigned char acc[64];  // the simulator keeps its stand-in for the hash state here
+} cx_sha512_t;
+
+int cx_sha512_init(cx_sha512_t *hash);
+
+int cx_hash(cx_hash_t *hash, int mode, const unsigned char *in, unsigned int len,
+            unsigned char *out, unsigned int out_len);
+
+int cx_ecfp_init_private_key(unsigned int curve, const unsigned char *rawkey, unsigned int key_len,
+                             cx_ecfp_private_key_t *pvkey);
+
+int cx_ecfp_init_public_key(unsigned int curve, const unsigned char *rawkey, unsigned int key_len,
+                            cx_ecfp_public_key_t *key);
+
+int cx_ecfp_generate_pair(unsigned int curve, cx_ecfp_public_key_t *pubkey,
+                          cx_ecfp_private_key_t *privkey, int keepprivate);
+
+int cx_hash_sha256(const unsigned char *in, unsigned int len, unsigned char *out, unsigned int out_len);
+
+int cx_hash_sha512(const unsigned char *in, unsigned int len, unsigned char *out, unsigned int out_len);
+
+int cx_eddsa_sign(const cx_ecfp_private_key_t *pvkey, int mode, int hashID,
+                  const unsigned char *hash, unsigned int hash_len,
+                  const unsigned char *ctx, unsigned int ctx_len,
+                  unsigned char *sig, unsigned int sig_len,
+                  unsigned int *info);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,123 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+
+// Minimal replacement of the BOLOS os.h used by the APDU simulator
+// Only what the app sources reference is provided
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "bolos_target.h"
+
+// Passed by the app Makefile on device builds
+#ifndef UNUSED
+#define UNUSED(x) (void) (x)
+#endif
+
+////// Exceptions
+// Same semantics as the SDK: THROW jumps to the innermost open TRY
+
+typedef unsigned short exception_t;
+
+typedef struct try_context_s {
+    jmp_buf jmp_buf;
+    struct try_context_s *previous;
+    exception_t ex;
+} try_context_t;
+
+extern try_context_t *G_try_last_open_context;
+
+#define EXCEPTION               1
+#define INVALID_PARAMETER       2
+#define EXCEPTION_SECURITY      3
+#define INVALID_STATE           4
+#define EXCEPTION_IO_OVERFLOW   5
+#define EXCEPTION_IO_RESET      0x10
+
+#define BEGIN_TRY { try_context_t __try_context;
+
+#define TRY \
+    __try_context.previous = G_try_last_open_context; \
+    G_try_last_open_context = &__try_context; \
+    __try_context.ex = (exception_t) setjmp(__try_context.jmp_buf); \
+    if (__try_context.ex == 0) {
+
+#define CATCH(x) \
+        goto __FINALLY; \
+    } else if (__try_context.ex == (x)) { \
+        G_try_last_open_context = __try_context.previous;
+
+#define CATCH_OTHER(e) \
+        goto __FINALLY; \
+    } else { \
+        exception_t e; \
+        e = __try_context.ex; \
+        __try_context.ex = 0; \
+        G_try_last_open_context = __try_context.previous;
+
+#define FINALLY \
+        goto __FINALLY; \
+    } \
+    __FINALLY: \
+    if (G_try_last_open_context == &__try_context) { \
+        G_try_last_open_context = __try_context.previous; \
+    }
+
+#define END_TRY \
+    if (__try_context.ex != 0) { \
+        THROW(__try_context.ex); \
+    } \
+}
+
+#define THROW(x) longjmp(G_try_last_open_context->jmp_buf, (x))
+
+////// Memory
+
+#define PIC(x) ((void *) (x))
+
+#define os_memmove memmove
+#define os_memcpy memcpy
+#define os_memset memset
+#define os_memcmp memcmp
+
+/// Writes to the app data area. Counted by the simulator
+void nvm_write(void *dst_adr, void *src_adr, unsigned int src_len);
+
+////// System
+
+void os_sched_exit(unsigned int exit_code);
+
+void reset(void);
+
+////// Key derivation
+
+#define HDW_NORMAL          0
+#define HDW_ED25519_SLIP10  1
+
+void os_perso_derive_node_bip32_seed_key(unsigned int mode, unsigned int curve,
+                                         const unsigned int *path, unsigned int pathLength,
+                                         unsigned char *privateKey, unsigned char *chain,
+                                         unsigned char *seed_key, unsigned int seed_key_length);
+
+#ifdef __cplusplus
+}
+#endif
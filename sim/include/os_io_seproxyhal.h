@@ -0,0 +1,93 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+
+// Minimal replacement of the BOLOS SEPROXYHAL used by the APDU simulator
+// There is no screen or button: reviews are driven by the scripted user in sim_view.c
+
+#include "os.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IO_APDU_BUFFER_SIZE     260
+
+extern unsigned char G_io_apdu_buffer[IO_APDU_BUFFER_SIZE];
+extern unsigned char G_io_seproxyhal_spi_buffer[IO_SEPROXYHAL_BUFFER_SIZE_B];
+
+////// io_exchange
+
+#define CHANNEL_APDU            0
+#define CHANNEL_KEYBOARD        1
+#define CHANNEL_SPI             2
+
+#define IO_RESET_AFTER_REPLIED  0x80
+#define IO_RECEIVE_DATA         0x40
+#define IO_RETURN_AFTER_TX      0x20
+#define IO_ASYNCH_REPLY         0x10
+#define IO_FLAGS                0xF8
+
+/// Captures the reply of an asynchronous command
+unsigned short io_exchange(unsigned char channel_and_flags, unsigned short tx_len);
+
+////// SEPROXYHAL events
+
+#define SEPROXYHAL_TAG_BUTTON_PUSH_EVENT        0x05
+#define SEPROXYHAL_TAG_FINGER_EVENT             0x0C
+#define SEPROXYHAL_TAG_DISPLAY_PROCESSED_EVENT  0x0D
+#define SEPROXYHAL_TAG_TICKER_EVENT             0x0E
+
+void io_seproxyhal_init(void);
+
+void io_seproxyhal_general_status(void);
+
+unsigned int io_seproxyhal_spi_is_status_sent(void);
+
+void io_seproxyhal_spi_send(const unsigned char *buffer, unsigned short length);
+
+unsigned short io_seproxyhal_spi_recv(unsigned char *buffer, unsigned short maxlength, unsigned int flags);
+
+void USB_power(unsigned char enabled);
+
+////// UX
+
+#define BOLOS_UX_CONTINUE   0
+#define BOLOS_UX_IGNORE     1
+#define BOLOS_UX_OK         2
+
+typedef struct {
+    unsigned int len;
+} bolos_ux_params_t;
+
+typedef struct {
+    bolos_ux_params_t params;
+} ux_state_t;
+
+extern ux_state_t ux;
+
+#define UX_ALLOWED                  (ux.params.len != BOLOS_UX_IGNORE && ux.params.len != BOLOS_UX_CONTINUE)
+#define UX_DISPLAYED()              1
+#define UX_DISPLAYED_EVENT()
+#define UX_REDISPLAY()
+#define UX_DEFAULT_EVENT()
+#define UX_FINGER_EVENT(seph)
+#define UX_BUTTON_PUSH_EVENT(seph)
+#define UX_TICKER_EVENT(seph, callback)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,502 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+// APDU-level simulator of the app (Nano S build)
+//
+// Usage: iov_sim [--iterations N] [--chunk N] [--record FILE] [--replay FILE]
+//
+//  - without --replay, a trace is generated from built-in scenarios (version, addresses, signing, batches)
+//  - --record writes the trace to FILE, --replay runs a trace read from FILE
+//  - the trace is run N times; every reply must match the recorded one
+//
+// Latencies are measured on the host and crypto is replaced by deterministic stand-ins,
+// so numbers are useful to compare protocol and parser changes, not to predict device timings.
+//
+// Trace format (little endian):
+//   "IOVT" | version (1) | records...
+//   record: type (1) | length (2) | data (length)
+//   types:  1 = command, 2 = expected reply (data + SW), 3 = user answer to the next review (1 byte)
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "tx_builder.h"
+
+#include "sim.h"
+#include "app_main.h"
+#include "tx.h"
+#include "actions.h"
+#include "lib/crypto.h"
+#include "parser_txdef.h"
+
+namespace {
+    typedef bench::bytes_t bytes_t;
+
+    const char TRACE_MAGIC[4] = {'I', 'O', 'V', 'T'};
+    const uint8_t TRACE_VERSION = 1;
+
+    enum record_type_t : uint8_t {
+        record_command = 1,
+        record_reply = 2,
+        record_user = 3,
+    };
+
+    struct step_t {
+        bytes_t command;
+        uint8_t action;             // answer of the user, if the command triggers a review
+        bytes_t reply;              // expected reply, empty if unknown
+        uint16_t sw;                // expected status word of a built-in scenario, 0 for the default
+        size_t sameReplyAs;         // step of a built-in scenario that must give the same reply, 0 for none
+    };
+
+    typedef std::vector<step_t> trace_t;
+
+    uint16_t sw_of(const bytes_t &reply) {
+        if (reply.size() < 2) {
+            return 0;
+        }
+        return (uint16_t) (reply[reply.size() - 2] << 8u | reply[reply.size() - 1]);
+    }
+
+    ////// Trace file
+
+    bool write_trace(const char *filename, const trace_t &trace) {
+        FILE *f = fopen(filename, "wb");
+        if (f == nullptr) {
+            fprintf(stderr, "cannot open %s\n", filename);
+            return false;
+        }
+
+        const auto put_record = [&](uint8_t type, const bytes_t &data) {
+            const uint8_t header[3] = {type, (uint8_t) data.size(), (uint8_t) (data.size() >> 8u)};
+            fwrite(header, 1, sizeof(header), f);
+            fwrite(data.data(), 1, data.size(), f);
+        };
+
+        fwrite(TRACE_MAGIC, 1, sizeof(TRACE_MAGIC), f);
+        fputc(TRACE_VERSION, f);
+        for (const auto &step : trace) {
+            if (step.action != SIM_USER_ACCEPT) {
+                put_record(record_user, {step.action});
+            }
+            put_record(record_command, step.command);
+            if (!step.reply.empty()) {
+                put_record(record_reply, step.reply);
+            }
+        }
+
+        const bool ok = ferror(f) == 0;
+        fclose(f);
+        return ok;
+    }
+
+    bool read_trace(const char *filename, trace_t &trace) {
+        FILE *f = fopen(filename, "rb");
+        if (f == nullptr) {
+            fprintf(stderr, "cannot open %s\n", filename);
+            return false;
+        }
+
+        bytes_t data;
+        int c;
+        while ((c = fgetc(f)) != EOF) {
+            data.push_back((uint8_t) c);
+        }
+        fclose(f);
+
+        if (data.size() < 5 || memcmp(data.data(), TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0) {
+            fprintf(stderr, "%s is not a trace\n", filename);
+            return false;
+        }
+        if (data[4] != TRACE_VERSION) {
+            fprintf(stderr, "unsupported trace version %d\n", data[4]);
+            return false;
+        }
+
+        uint8_t action = SIM_USER_ACCEPT;
+        size_t pos = 5;
+        while (pos < data.size()) {
+            if (data.size() - pos < 3) {
+                fprintf(stderr, "truncated record at offset %zu\n", pos);
+                return false;
+            }
+            const uint8_t type = data[pos];
+            const size_t len = data[pos + 1] | (size_t) data[pos + 2] << 8u;
+            pos += 3;
+            if (data.size() - pos < len) {
+                fprintf(stderr, "truncated record at offset %zu\n", pos);
+                return false;
+            }
+            const bytes_t payload(data.begin() + pos, data.begin() + pos + len);
+            pos += len;
+
+            switch (type) {
+                case record_command:
+                    trace.push_back({payload, action, {}, 0, 0});
+                    action = SIM_USER_ACCEPT;
+                    break;
+                case record_reply:
+                    if (trace.empty()) {
+                        fprintf(stderr, "reply without command\n");
+                        return false;
+                    }
+                    trace.back().reply = payload;
+                    break;
+                case record_user:
+                    action = payload.empty() ? SIM_USER_ACCEPT : payload[0];
+                    break;
+                default:
+                    fprintf(stderr, "unknown record type %d\n", type);
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    ////// Scenarios
+
+    bytes_t apdu(uint8_t ins, uint8_t p1, uint8_t p2, const bytes_t &payload) {
+        bytes_t command = {CLA, ins, p1, p2, (uint8_t) payload.size()};
+        command.insert(command.end(), payload.begin(), payload.end());
+        return command;
+    }
+
+    bytes_t path_bytes(uint32_t index) {
+        const uint32_t path[BIP32_LEN_DEFAULT] = {BIP32_PATH_0, BIP32_PATH_1, 0x80000000u | index};
+        bytes_t out(sizeof(path));
+        memcpy(out.data(), path, sizeof(path));
+        return out;
+    }
+
+    // Splits a message as the host libraries do: the path first, then chunks of at most chunkSize bytes
+    void add_chunked(trace_t &trace, uint8_t ins, uint32_t index, const bytes_t &message,
+                     size_t chunkSize, uint8_t action) {
+        std::vector<bytes_t> chunks = {path_bytes(index)};
+        for (size_t i = 0; i < message.size(); i += chunkSize) {
+            const size_t n = std::min(chunkSize, message.size() - i);
+            chunks.emplace_back(message.begin() + i, message.begin() + i + n);
+        }
+
+        for (size_t i = 0; i < chunks.size(); i++) {
+            trace.push_back({apdu(ins, (uint8_t) (i + 1), (uint8_t) chunks.size(), chunks[i]), action, {}, 0, 0});
+        }
+    }
+
+    // version | len(chainID) | chainID | nonce
+    size_t header_len(const bytes_t &message) {
+        return 4 + 1 + message[4] + 8;
+    }
+
+    // A transaction that the device rejects once its first rejectedAt bytes have been received
+    // The host does not send the remaining chunks
+    void add_rejected(trace_t &trace, uint8_t ins, const bytes_t &message, size_t chunkSize, size_t rejectedAt) {
+        const size_t first = trace.size();
+        add_chunked(trace, ins, 0, message, chunkSize, SIM_USER_ACCEPT);
+
+        const size_t last = first + (rejectedAt + chunkSize - 1) / chunkSize;
+        trace.resize(last + 1);
+        trace[last].sw = APDU_CODE_DATA_INVALID;
+    }
+
+    bytes_t batch_of(const std::vector<bytes_t> &txs) {
+        bytes_t batch;
+        for (const auto &t : txs) {
+            batch.push_back((uint8_t) (t.size() >> 8u));
+            batch.push_back((uint8_t) t.size());
+            batch.insert(batch.end(), t.begin(), t.end());
+        }
+        return batch;
+    }
+
+    trace_t build_scenarios(size_t chunkSize) {
+        const bytes_t small = bench::build_tx({"iov-lovenet", 1, 10, 0, 0, 10000000, "", 0});
+        const bytes_t typical = bench::build_tx({"iov-lovenet", 42, 1234, 500000000, 0, 10000000,
+                                                 "payout #42", 1});
+        const bytes_t worst = bench::build_tx({"iov-lovenet", UINT64_MAX >> 1u, 999999999999999, 999999999,
+                                               999999999999999, 999999999, std::string(TX_MEMOLEN_MAX, 'm'), 8});
+
+        trace_t trace;
+        trace.push_back({apdu(INS_GET_VERSION, 0, 0, {}), SIM_USER_ACCEPT, {}, 0, 0});
+
+        // Addresses, silent and confirmed
+        trace.push_back({apdu(INS_GET_ADDR_ED25519, 0, 0, path_bytes(0)), SIM_USER_ACCEPT, {}, 0, 0});
+        trace.push_back({apdu(INS_GET_ADDR_ED25519, 1, 0, path_bytes(0)), SIM_USER_ACCEPT, {}, 0, 0});
+
+        // Account scan
+        bytes_t scan = path_bytes(0);
+        scan.push_back(20);
+        trace.push_back({apdu(INS_GET_ADDR_BATCH_ED25519, CRYPTO_ADDR_FORMAT_PUBKEY, 0, scan), SIM_USER_ACCEPT, {}, 0, 0});
+        trace.push_back({apdu(INS_GET_ADDR_BATCH_ED25519, CRYPTO_ADDR_FORMAT_HASH, 0, scan), SIM_USER_ACCEPT, {}, 0, 0});
+
+        // Single transactions
+        add_chunked(trace, INS_SIGN_ED25519, 0, small, chunkSize, SIM_USER_ACCEPT);
+        add_chunked(trace, INS_SIGN_ED25519, 0, typical, chunkSize, SIM_USER_ACCEPT);
+        const size_t typicalSigned = trace.size() - 1;
+        add_chunked(trace, INS_SIGN_ED25519, 0, worst, chunkSize, SIM_USER_ACCEPT);
+        add_chunked(trace, INS_SIGN_ED25519, 1, typical, chunkSize, SIM_USER_REJECT);
+
+        // Multisig entries are read from the transaction buffer, up to the display limit
+        add_chunked(trace, INS_SIGN_ED25519, 0,
+                    bench::build_tx({"iov-lovenet", 7, 1, 0, 0, 10000000, "", PBIDX_MULTISIG_COUNT_MAX}),
+                    chunkSize, SIM_USER_ACCEPT);
+
+        // An address shown while a transaction is being received takes over the memory of its digest
+        // The signature must not change
+        const size_t interleaved = trace.size();
+        add_chunked(trace, INS_SIGN_ED25519, 0, typical, chunkSize, SIM_USER_ACCEPT);
+        trace.insert(trace.begin() + interleaved + 1,
+                     {apdu(INS_GET_ADDR_ED25519, 1, 0, path_bytes(0)), SIM_USER_ACCEPT, {}, 0, 0});
+        trace.back().sameReplyAs = typicalSigned;
+
+        // Bad jobs, a bad version is seen on the first chunk and the network once the header is complete
+        bytes_t badVersion = worst;
+        badVersion[1] ^= 0x01u;
+        add_rejected(trace, INS_SIGN_ED25519, badVersion, chunkSize, 4);
+        const bytes_t mainnet = bench::build_tx({"iov-mainnet", 42, 1234, 500000000, 0, 10000000, "payout #42", 1});
+        add_rejected(trace, INS_SIGN_ED25519, mainnet, chunkSize, header_len(mainnet));
+
+        // A full batch, then the signatures that did not fit in the reply
+        std::vector<bytes_t> txs;
+        for (uint8_t i = 0; i < TX_BATCH_MAX; i++) {
+            txs.push_back(bench::build_tx({"iov-lovenet", 100u + i, 5u + i, 0, 0, 10000000, "batch", 0}));
+        }
+        add_chunked(trace, INS_SIGN_BATCH_ED25519, 0, batch_of(txs), chunkSize, SIM_USER_ACCEPT);
+        for (uint8_t first = BATCH_SIGNATURES_PER_APDU; first < TX_BATCH_MAX; first += BATCH_SIGNATURES_PER_APDU) {
+            trace.push_back({apdu(INS_GET_BATCH_SIGNATURES, first, 0, {}), SIM_USER_ACCEPT, {}, 0, 0});
+        }
+
+        // The same batch again, e.g. after a reconnection. Flash pages that did not change are not written
+        add_chunked(trace, INS_SIGN_BATCH_ED25519, 0, batch_of(txs), chunkSize, SIM_USER_ACCEPT);
+
+        // Large transactions overflow the RAM buffer, they continue in flash
+        add_chunked(trace, INS_SIGN_BATCH_ED25519, 0, batch_of({worst, typical, worst}), chunkSize, SIM_USER_ACCEPT);
+
+        return trace;
+    }
+
+    ////// Replay
+
+    struct ins_stats_t {
+        uint64_t ops = 0;
+        uint64_t apdus = 0;
+        uint64_t bytesIn = 0;
+        uint64_t bytesOut = 0;
+        uint64_t frames = 0;
+        double ns = 0;
+        sim_counters_t counters = {};
+    };
+
+    const char *ins_name(uint8_t ins) {
+        switch (ins) {
+            case INS_GET_VERSION:
+                return "GET_VERSION";
+            case INS_GET_ADDR_ED25519:
+                return "GET_ADDR";
+            case INS_SIGN_ED25519:
+                return "SIGN";
+            case INS_SIGN_BATCH_ED25519:
+                return "SIGN_BATCH";
+            case INS_GET_BATCH_SIGNATURES:
+                return "GET_BATCH_SIGNATURES";
+            case INS_GET_ADDR_BATCH_ED25519:
+                return "GET_ADDR_BATCH";
+            default:
+                return "?";
+        }
+    }
+
+    // 64 byte HID reports: 5 byte header, the first report also carries the APDU length (2 bytes)
+    uint64_t hid_frames(size_t len) {
+        return (len + 2 + 58) / 59;
+    }
+
+    bool is_chunked(uint8_t ins) {
+        return ins == INS_SIGN_ED25519 || ins == INS_SIGN_BATCH_ED25519;
+    }
+
+    void add_counters(sim_counters_t &acc, const sim_counters_t &before, const sim_counters_t &after) {
+        acc.derivations += after.derivations - before.derivations;
+        acc.publicKeys += after.publicKeys - before.publicKeys;
+        acc.signatures += after.signatures - before.signatures;
+        acc.hashes += after.hashes - before.hashes;
+        acc.nvmWrites += after.nvmWrites - before.nvmWrites;
+        acc.nvmBytes += after.nvmBytes - before.nvmBytes;
+        acc.nvmPages += after.nvmPages - before.nvmPages;
+        acc.hashedBytes += after.hashedBytes - before.hashedBytes;
+        acc.approvalHashedBytes += after.approvalHashedBytes - before.approvalHashedBytes;
+        acc.reviews += after.reviews - before.reviews;
+        acc.screens += after.screens - before.screens;
+        acc.reviewErrors += after.reviewErrors - before.reviewErrors;
+    }
+
+    // Runs the trace on a fresh device. Missing replies are filled in, others must match
+    bool run_trace(trace_t &trace, std::map<uint8_t, ins_stats_t> &stats) {
+        sim_init();
+
+        bool ok = true;
+        uint8_t reply[IO_APDU_BUFFER_SIZE];
+        for (size_t i = 0; i < trace.size(); i++) {
+            auto &step = trace[i];
+            const uint8_t ins = step.command.size() > OFFSET_INS ? step.command[OFFSET_INS] : 0xFF;
+            auto &s = stats[ins];
+
+            const sim_counters_t before = sim_counters;
+            const auto start = std::chrono::steady_clock::now();
+            const uint16_t replyLen = sim_exchange(step.command.data(), (uint16_t) step.command.size(),
+                                                   step.action, reply, sizeof(reply));
+            const auto end = std::chrono::steady_clock::now();
+            add_counters(s.counters, before, sim_counters);
+
+            s.ns += std::chrono::duration<double, std::nano>(end - start).count();
+            s.apdus++;
+            s.bytesIn += step.command.size();
+            s.bytesOut += replyLen;
+            s.frames += hid_frames(step.command.size()) + hid_frames(replyLen);
+
+            const bytes_t got(reply, reply + replyLen);
+            const bool lastChunk = !is_chunked(ins) ||
+                                   step.command[OFFSET_PCK_INDEX] == step.command[OFFSET_PCK_COUNT] ||
+                                   sw_of(got) != APDU_CODE_OK;
+            if (lastChunk) {
+                s.ops++;
+            }
+
+            if (step.reply.empty()) {
+                step.reply = got;
+            } else if (step.reply != got) {
+                fprintf(stderr, "step %zu (%s): reply differs from trace, SW %04X expected %04X\n",
+                        i, ins_name(ins), sw_of(got), sw_of(step.reply));
+                ok = false;
+            }
+        }
+
+        return ok;
+    }
+
+    void print_report(const std::map<uint8_t, ins_stats_t> &stats, uint32_t iterations) {
+        printf("\n%-22s %6s %8s %9s %9s %7s %10s %7s %7s %7s %9s %8s %9s\n",
+               "instruction", "ops", "apdu/op", "in/op", "out/op", "hid/op",
+               "us/op", "drv/op", "sig/op", "scr/op", "nvm B/op", "pg/op", "apr hB/op");
+        printf("------------------------------------------------------------------------------------------------------------------------------\n");
+
+        for (const auto &entry : stats) {
+            const auto &s = entry.second;
+            if (s.ops == 0) {
+                continue;
+            }
+            const double ops = (double) s.ops;
+            printf("%-22s %6llu %8.2f %9.1f %9.1f %7.1f %10.2f %7.2f %7.2f %7.1f %9.1f %8.2f %9.1f\n",
+                   ins_name(entry.first),
+                   (unsigned long long) (s.ops / iterations),
+                   s.apdus / ops, s.bytesIn / ops, s.bytesOut / ops, s.frames / ops,
+                   s.ns / ops / 1000.0,
+                   s.counters.derivations / ops, s.counters.signatures / ops,
+                   s.counters.screens / ops, s.counters.nvmBytes / ops, s.counters.nvmPages / ops,
+                   s.counters.approvalHashedBytes / ops);
+        }
+    }
+
+    bool check_scenarios(const trace_t &trace) {
+        // The generated trace must not hide failures: everything succeeds except rejected reviews and bad jobs
+        bool ok = true;
+        for (size_t i = 0; i < trace.size(); i++) {
+            uint16_t expected = trace[i].action == SIM_USER_REJECT &&
+                                trace[i].command[OFFSET_PCK_INDEX] == trace[i].command[OFFSET_PCK_COUNT]
+                                ? APDU_CODE_COMMAND_NOT_ALLOWED : APDU_CODE_OK;
+            if (trace[i].sw != 0) {
+                expected = trace[i].sw;
+            }
+            const uint16_t sw = sw_of(trace[i].reply);
+            if (sw != expected) {
+                fprintf(stderr, "scenario step %zu (%s): SW %04X expected %04X\n",
+                        i, ins_name(trace[i].command[OFFSET_INS]), sw, expected);
+                ok = false;
+            }
+            const size_t same = trace[i].sameReplyAs;
+            if (same != 0 && trace[i].reply != trace[same].reply) {
+                fprintf(stderr, "scenario step %zu (%s): reply differs from step %zu\n",
+                        i, ins_name(trace[i].command[OFFSET_INS]), same);
+                ok = false;
+            }
+        }
+        return ok;
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = 1000;
+    size_t chunkSize = 250;
+    const char *recordFile = nullptr;
+    const char *replayFile = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = (uint32_t) strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) {
+            chunkSize = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordFile = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayFile = argv[++i];
+        } else {
+            fprintf(stderr, "unknown argument %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (iterations == 0) {
+        iterations = 1;
+    }
+    if (chunkSize == 0 || chunkSize > 255) {
+        fprintf(stderr, "chunk size must be between 1 and 255\n");
+        return EXIT_FAILURE;
+    }
+
+    trace_t trace;
+    std::map<uint8_t, ins_stats_t> stats;
+    if (replayFile != nullptr) {
+        if (!read_trace(replayFile, trace)) {
+            return EXIT_FAILURE;
+        }
+        printf("replaying %s: %zu commands\n", replayFile, trace.size());
+    } else {
+        trace = build_scenarios(chunkSize);
+        printf("built-in scenarios: %zu commands, %zu byte chunks\n", trace.size(), chunkSize);
+
+        // First run records the replies
+        if (!run_trace(trace, stats) || !check_scenarios(trace)) {
+            return EXIT_FAILURE;
+        }
+        stats.clear();
+
+        if (recordFile != nullptr && !write_trace(recordFile, trace)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (!run_trace(trace, stats)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    print_report(stats, iterations);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Answers given by the scripted user when a command requires a review
+#define SIM_USER_REJECT 0
+#define SIM_USER_ACCEPT 1
+
+// Flash is programmed by pages of this size
+#define SIM_NVM_PAGE_SIZE 64
+
+// Work done by the device, accumulated over every exchange
+typedef struct {
+    uint32_t derivations;       // bip32 key derivations
+    uint32_t publicKeys;        // public key computations
+    uint32_t signatures;        // ed25519 signatures
+    uint32_t hashes;            // sha256/sha512 calls
+    uint32_t hashedBytes;       // bytes passed to sha256/sha512
+    uint32_t approvalHashedBytes;   // part of hashedBytes hashed once the user approved a signature
+    uint32_t nvmWrites;         // writes to the app data area
+    uint32_t nvmBytes;          // bytes written to the app data area
+    uint32_t nvmPages;          // flash pages programmed, a write programs every page it touches
+    uint32_t reviews;           // commands that waited for the user
+    uint32_t screens;           // review screens rendered, including pages
+    uint32_t reviewErrors;      // reviews that could not be rendered
+} sim_counters_t;
+
+extern sim_counters_t sim_counters;
+
+/// Entry point of app_main.c
+void handleApdu(volatile uint32_t *flags, volatile uint32_t *tx, uint32_t rx);
+
+/// Powers up the device, all app state and counters are cleared
+void sim_init();
+
+/// Sends a command and waits for its reply
+/// If the command asks for a review, the scripted user walks every screen and answers with action
+/// \return reply length, including the return code. Zero if the device did not reply
+uint16_t sim_exchange(const uint8_t *command, uint16_t commandLen, uint8_t action,
+                      uint8_t *reply, uint16_t replyMaxLen);
+
+/// Returns non-zero if the last exchange required a review
+uint8_t sim_last_exchange_reviewed();
+
+////// Internal, shared by the simulator sources
+
+/// Drives the review started by the last command to completion
+/// \return zero if no review was pending
+uint8_t sim_user_review(uint8_t action);
+
+#ifdef __cplusplus
+}
+#endif
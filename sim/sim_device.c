@@ -0,0 +1,348 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+// Device side of the APDU simulator: BOLOS services, transport and crypto stand-ins
+
+#include <os.h>
+#include <os_io_seproxyhal.h>
+#include <cx.h>
+
+#include "sim.h"
+#include "app_main.h"
+#include "tx.h"
+#include "actions.h"
+#include "apdu_codes.h"
+#include "lib/crypto.h"
+
+// External definition of the inline helper in apdu_codes.h
+extern void set_code(uint8_t *buffer, uint8_t offset, uint16_t value);
+
+sim_counters_t sim_counters;
+
+try_context_t *G_try_last_open_context;
+unsigned char G_io_apdu_buffer[IO_APDU_BUFFER_SIZE];
+ux_state_t ux;
+unsigned int app_stack_canary;
+
+// Reply of the current exchange
+uint8_t *sim_reply;
+uint16_t sim_reply_maxlen;
+uint16_t sim_reply_len;
+uint8_t sim_reviewed;
+
+// App data area written so far, erased when the device is reset
+uint8_t *sim_nvm_lo;
+uint8_t *sim_nvm_hi;
+
+////// BOLOS services
+
+void debug_printf(void *buffer) {
+    UNUSED(buffer);
+}
+
+void nvm_write(void *dst_adr, void *src_adr, unsigned int src_len) {
+    sim_counters.nvmWrites++;
+    sim_counters.nvmBytes += src_len;
+    if (src_len > 0) {
+        const uintptr_t first = (uintptr_t) dst_adr / SIM_NVM_PAGE_SIZE;
+        const uintptr_t last = ((uintptr_t) dst_adr + src_len - 1) / SIM_NVM_PAGE_SIZE;
+        sim_counters.nvmPages += last - first + 1;
+
+        uint8_t *lo = (uint8_t *) dst_adr;
+        if (sim_nvm_lo == NULL || lo < sim_nvm_lo) {
+            sim_nvm_lo = lo;
+        }
+        if (lo + src_len > sim_nvm_hi) {
+            sim_nvm_hi = lo + src_len;
+        }
+    }
+    memmove(dst_adr, src_adr, src_len);
+}
+
+void os_sched_exit(unsigned int exit_code) {
+    UNUSED(exit_code);
+}
+
+void reset(void) {
+}
+
+////// Transport
+
+void io_seproxyhal_init(void) {
+}
+
+void io_seproxyhal_general_status(void) {
+}
+
+unsigned int io_seproxyhal_spi_is_status_sent(void) {
+    return 1;
+}
+
+void io_seproxyhal_spi_send(const unsigned char *buffer, unsigned short length) {
+    UNUSED(buffer);
+    UNUSED(length);
+}
+
+unsigned short io_seproxyhal_spi_recv(unsigned char *buffer, unsigned short maxlength, unsigned int flags) {
+    UNUSED(buffer);
+    UNUSED(maxlength);
+    UNUSED(flags);
+    return 0;
+}
+
+void USB_power(unsigned char enabled) {
+    UNUSED(enabled);
+}
+
+unsigned short io_exchange(unsigned char channel_and_flags, unsigned short tx_len) {
+    UNUSED(channel_and_flags);
+
+    // Only replies go through here, the next command is passed to sim_exchange
+    if (tx_len > sim_reply_maxlen) {
+        tx_len = sim_reply_maxlen;
+    }
+    MEMCPY(sim_reply, G_io_apdu_buffer, tx_len);
+    sim_reply_len = tx_len;
+    return 0;
+}
+
+////// Crypto stand-ins
+// Outputs only depend on the inputs, so traces can be replayed and compared.
+// They have no cryptographic value and they do not model the cost of the real primitives
+
+static uint64_t sim_mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30u)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27u)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31u);
+}
+
+static uint64_t sim_digest_init(uint64_t seed) {
+    return 0xCBF29CE484222325ull ^ seed;
+}
+
+static uint64_t sim_digest_update(uint64_t h, const unsigned char *in, unsigned int len) {
+    for (unsigned int i = 0; i < len; i++) {
+        h = (h ^ in[i]) * 0x100000001B3ull;
+    }
+    return h;
+}
+
+static void sim_digest_final(uint64_t h, unsigned char *out, unsigned int out_len) {
+    for (unsigned int i = 0; i < out_len; i += 8) {
+        h = sim_mix(h);
+        for (unsigned int j = 0; j < 8 && i + j < out_len; j++) {
+            out[i + j] = (unsigned char) (h >> (8u * j));
+        }
+    }
+}
+
+static void sim_digest(uint64_t seed, const unsigned char *in, unsigned int len,
+                       unsigned char *out, unsigned int out_len) {
+    sim_digest_final(sim_digest_update(sim_digest_init(seed), in, len), out, out_len);
+}
+
+void os_perso_derive_node_bip32_seed_key(unsigned int mode, unsigned int curve,
+                                         const unsigned int *path, unsigned int pathLength,
+                                         unsigned char *privateKey, unsigned char *chain,
+                                         unsigned char *seed_key, unsigned int seed_key_length) {
+    UNUSED(chain);
+    UNUSED(seed_key);
+    UNUSED(seed_key_length);
+
+    sim_counters.derivations++;
+    sim_digest(((uint64_t) mode << 32u) | curve,
+               (const unsigned char *) path, pathLength * sizeof(unsigned int),
+               privateKey, 32);
+}
+
+int cx_ecfp_init_private_key(unsigned int curve, const unsigned char *rawkey, unsigned int key_len,
+                             cx_ecfp_private_key_t *pvkey) {
+    pvkey->curve = curve;
+    pvkey->d_len = key_len;
+    MEMCPY(pvkey->d, rawkey, key_len);
+    return key_len;
+}
+
+int cx_ecfp_init_public_key(unsigned int curve, const unsigned char *rawkey, unsigned int key_len,
+                            cx_ecfp_public_key_t *key) {
+    key->curve = curve;
+    key->W_len = key_len;
+    if (rawkey != NULL) {
+        MEMCPY(key->W, rawkey, key_len);
+    }
+    return key_len;
+}
+
+int cx_ecfp_generate_pair(unsigned int curve, cx_ecfp_public_key_t *pubkey,
+                          cx_ecfp_private_key_t *privkey, int keepprivate) {
+    UNUSED(keepprivate);
+
+    sim_counters.publicKeys++;
+    pubkey->curve = curve;
+    pubkey->W_len = sizeof(pubkey->W);
+    pubkey->W[0] = 0x04;
+    sim_digest(curve, privkey->d, privkey->d_len, pubkey->W + 1, sizeof(pubkey->W) - 1);
+    return 0;
+}
+
+int cx_hash_sha256(const unsigned char *in, unsigned int len, unsigned char *out, unsigned int out_len) {
+    sim_counters.hashes++;
+    sim_counters.hashedBytes += len;
+    sim_digest(CX_SHA256, in, len, out, out_len < CX_SHA256_SIZE ? out_len : CX_SHA256_SIZE);
+    return CX_SHA256_SIZE;
+}
+
+int cx_hash_sha512(const unsigned char *in, unsigned int len, unsigned char *out, unsigned int out_len) {
+    sim_counters.hashes++;
+    sim_counters.hashedBytes += len;
+    sim_digest(CX_SHA512, in, len, out, out_len < CX_SHA512_SIZE ? out_len : CX_SHA512_SIZE);
+    return CX_SHA512_SIZE;
+}
+
+int cx_sha512_init(cx_sha512_t *hash) {
+    hash->header.algo = CX_SHA512;
+    const uint64_t state = sim_digest_init(CX_SHA512);
+    memcpy(hash->acc, &state, sizeof(state));
+    return CX_SHA512;
+}
+
+int cx_hash(cx_hash_t *hash, int mode, const unsigned char *in, unsigned int len,
+            unsigned char *out, unsigned int out_len) {
+    // Only SHA512 contexts are used incrementally
+    cx_sha512_t *ctx = (cx_sha512_t *) hash;
+    uint64_t state;
+    memcpy(&state, ctx->acc, sizeof(state));
+
+    sim_counters.hashedBytes += len;
+    state = sim_digest_update(state, in, len);
+    memcpy(ctx->acc, &state, sizeof(state));
+    if ((mode & CX_LAST) == 0) {
+        return 0;
+    }
+
+    // Same result as hashing everything at once
+    sim_counters.hashes++;
+    const unsigned int size = hash->algo == CX_SHA512 ? CX_SHA512_SIZE : CX_SHA256_SIZE;
+    sim_digest_final(state, out, out_len < size ? out_len : size);
+    return size;
+}
+
+int cx_eddsa_sign(const cx_ecfp_private_key_t *pvkey, int mode, int hashID,
+                  const unsigned char *hash, unsigned int hash_len,
+                  const unsigned char *ctx, unsigned int ctx_len,
+                  unsigned char *sig, unsigned int sig_len,
+                  unsigned int *info) {
+    UNUSED(mode);
+    UNUSED(hashID);
+    UNUSED(ctx);
+    UNUSED(ctx_len);
+
+    if (sig_len < ED25519_SIGNATURE_LEN) {
+        return 0;
+    }
+
+    // Bind the signature to both the key and the message
+    uint64_t seed = 0;
+    for (unsigned int i = 0; i < pvkey->d_len; i++) {
+        seed = sim_mix(seed ^ pvkey->d[i]);
+    }
+
+    sim_counters.signatures++;
+    sim_digest(seed, hash, hash_len, sig, ED25519_SIGNATURE_LEN);
+    *info = 0;
+    return ED25519_SIGNATURE_LEN;
+}
+
+////// Simulator API
+
+void sim_init() {
+    // A fresh device does not hold what a previous run wrote to flash
+    if (sim_nvm_lo != NULL) {
+        MEMSET(sim_nvm_lo, 0, sim_nvm_hi - sim_nvm_lo);
+        sim_nvm_lo = sim_nvm_hi = NULL;
+    }
+
+    MEMSET(&sim_counters, 0, sizeof(sim_counters));
+    G_try_last_open_context = NULL;
+    ux.params.len = BOLOS_UX_OK;
+
+    crypto_clearKeyCache();
+    app_clear_batch_signatures();
+    tx_initialize();
+    tx_reset();
+    app_init();
+}
+
+uint8_t sim_last_exchange_reviewed() {
+    return sim_reviewed;
+}
+
+uint16_t sim_exchange(const uint8_t *command, uint16_t commandLen, uint8_t action,
+                      uint8_t *reply, uint16_t replyMaxLen) {
+    if (commandLen > sizeof(G_io_apdu_buffer)) {
+        return 0;
+    }
+
+    sim_reply = reply;
+    sim_reply_maxlen = replyMaxLen;
+    sim_reply_len = 0;
+    sim_reviewed = 0;
+
+    MEMCPY(G_io_apdu_buffer, command, commandLen);
+
+    // Same steps as one iteration of app_main
+    volatile uint32_t flags = 0;
+    volatile uint32_t tx = 0;
+
+    BEGIN_TRY
+    {
+        TRY
+        {
+            if (commandLen == 0) {
+                THROW(APDU_CODE_EMPTY_BUFFER);
+            }
+
+            handleApdu(&flags, &tx, commandLen);
+
+            if (flags & IO_ASYNCH_REPLY) {
+                sim_reviewed = sim_user_review(action);
+            } else {
+                io_exchange(CHANNEL_APDU, tx);
+            }
+        }
+        CATCH_OTHER(e)
+        {
+            uint16_t sw;
+            switch (e & 0xF000) {
+                case 0x6000:
+                case 0x9000:
+                    sw = e;
+                    break;
+                default:
+                    sw = 0x6800 | (e & 0x7FF);
+                    break;
+            }
+            set_code(G_io_apdu_buffer, tx, sw);
+            io_exchange(CHANNEL_APDU, tx + 2);
+        }
+        FINALLY
+        {}
+    }
+    END_TRY;
+
+    return sim_reply_len;
+}
@@ -0,0 +1,148 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+// View of the APDU simulator. Replaces view.c and drives reviews with a scripted user
+// The handlers below perform the same steps as the ones in view.c, without UX
+
+#include <os_io_seproxyhal.h>
+
+#include "sim.h"
+#include "view.h"
+#include "view_internal.h"
+#include "actions.h"
+#include "tx.h"
+#include "apdu_codes.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef enum {
+    sim_review_none = 0,
+    sim_review_address,
+    sim_review_error,
+    sim_review_sign,
+} sim_review_t;
+
+sim_review_t sim_review;
+
+const char *address;
+
+void view_init() {
+    sim_review = sim_review_none;
+}
+
+void view_idle_show(unsigned int ignored) {
+    UNUSED(ignored);
+    sim_review = sim_review_none;
+}
+
+void view_error_show() {
+    arena_enter(arena_phase_review);
+    sim_review = sim_review_error;
+}
+
+void view_address_show() {
+    arena_enter(arena_phase_review);
+    // Address has been placed in the output buffer
+    address = (char *) (G_io_apdu_buffer + 32);
+    // Same screen as view_s.c
+    snprintf(viewdata.key, MAX_CHARS_PER_KEY_LINE, "%.12s", address);
+    snprintf(viewdata.value, MAX_CHARS_PER_VALUE1_LINE, "%s", address + strlen(viewdata.key));
+    sim_review = sim_review_address;
+}
+
+void view_sign_show() {
+    arena_enter(arena_phase_review);
+    sim_review = sim_review_sign;
+}
+
+// Same as view_s.c
+void splitValueField() {
+    viewdata.value2[0] = 0;
+    uint16_t vlen = strlen(viewdata.value);
+    if (vlen > MAX_CHARS_PER_VALUE2_LINE - 1) {
+        strcpy(viewdata.value2, viewdata.value + MAX_CHARS_PER_VALUE_LINE);
+        viewdata.value[MAX_CHARS_PER_VALUE_LINE] = 0;
+    }
+}
+
+// Goes through every item and page with the Nano S geometry, pressing right as in view_s.c
+bool_t sim_walk_review() {
+    h_review_init();
+
+    view_error_t err = h_review_update_data();
+    while (err == view_no_error) {
+        sim_counters.screens++;
+        h_review_prefetch();
+
+        h_review_increase();
+        err = h_review_update_data();
+    }
+
+    // The review must end after the last item, not on a screen that could not be rendered
+    return err == view_no_data && viewdata.idx == tx_getNumItems();
+}
+
+void sim_sign_accept() {
+    const uint32_t hashedBytes = sim_counters.hashedBytes;
+    const uint8_t replyLen = app_sign();
+    sim_counters.approvalHashedBytes += sim_counters.hashedBytes - hashedBytes;
+    view_idle_show(0);
+
+    set_code(G_io_apdu_buffer, replyLen, APDU_CODE_OK);
+    io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, replyLen + 2);
+}
+
+void sim_sign_reject() {
+    view_idle_show(0);
+
+    set_code(G_io_apdu_buffer, 0, APDU_CODE_COMMAND_NOT_ALLOWED);
+    io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, 2);
+}
+
+uint8_t sim_user_review(uint8_t action) {
+    const sim_review_t review = sim_review;
+
+    switch (review) {
+        case sim_review_address:
+        case sim_review_error:
+            // Both screens can only be acknowledged
+            sim_counters.screens++;
+            view_idle_show(0);
+            app_reply_address();
+            break;
+
+        case sim_review_sign:
+            if (!sim_walk_review()) {
+                // Nothing can be signed if the review cannot be shown completely
+                sim_counters.reviewErrors++;
+                sim_sign_reject();
+                break;
+            }
+            if (action == SIM_USER_ACCEPT) {
+                sim_sign_accept();
+            } else {
+                sim_sign_reject();
+            }
+            break;
+
+        default:
+            return 0;
+    }
+
+    sim_counters.reviews++;
+    return 1;
+}
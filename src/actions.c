@@ -21,12 +21,62 @@
 #include "apdu_codes.h"
 #include <os_io_seproxyhal.h>
 
+// Signatures of the last approved batch
+// Not in the arena: they are read by INS_GET_BATCH_SIGNATURES after the review is over,
+// possibly after other commands have used the arena
+uint8_t batch_signatures[TX_BATCH_MAX * ED25519_SIGNATURE_LEN];
+uint8_t batch_signatures_count;
+
 uint8_t app_sign() {
+    if (tx_batch_count() != 0) {
+        return app_sign_batch();
+    }
+
     uint8_t *signature = G_io_apdu_buffer;
-    const uint8_t *message = tx_get_buffer();
-    const uint16_t messageLength = tx_get_buffer_length();
+    const uint8_t *digest = tx_get_digest();
+    if (digest != NULL) {
+        return crypto_signDigest(signature, IO_APDU_BUFFER_SIZE - 2, digest);
+    }
+
+    segments_t message;
+    tx_get_message(&message);
+
+    return crypto_sign(signature, IO_APDU_BUFFER_SIZE - 2, &message);
+}
 
-    return crypto_sign(signature, IO_APDU_BUFFER_SIZE - 2, message, messageLength);
+uint8_t app_sign_batch() {
+    const uint8_t count = tx_batch_count();
+
+    batch_signatures_count = crypto_signBatch(batch_signatures, sizeof(batch_signatures),
+                                              tx_batch_get, count);
+    if (batch_signatures_count != count) {
+        app_clear_batch_signatures();
+        return 0;
+    }
+
+    // Reply with the number of signatures and as many of them as fit
+    G_io_apdu_buffer[0] = batch_signatures_count;
+    return 1 + app_fill_batch_signatures(G_io_apdu_buffer + 1, 0);
+}
+
+uint8_t app_fill_batch_signatures(uint8_t *buffer, uint8_t first) {
+    uint8_t n = 0;
+    while (n < BATCH_SIGNATURES_PER_APDU && first + n < batch_signatures_count) {
+        MEMCPY(buffer + n * ED25519_SIGNATURE_LEN,
+               batch_signatures + (first + n) * ED25519_SIGNATURE_LEN,
+               ED25519_SIGNATURE_LEN);
+        n++;
+    }
+    return n * ED25519_SIGNATURE_LEN;
+}
+
+uint8_t app_get_batch_signatures_count() {
+    return batch_signatures_count;
+}
+
+void app_clear_batch_signatures() {
+    MEMSET(batch_signatures, 0, sizeof(batch_signatures));
+    batch_signatures_count = 0;
 }
 
 void app_set_hrp(char *p) {
@@ -38,12 +88,32 @@ uint8_t app_fill_address() {
     return crypto_fillAddress(G_io_apdu_buffer, IO_APDU_BUFFER_SIZE);
 }
 
+uint8_t app_fill_address_batch(const uint32_t *path, uint8_t count, uint8_t format) {
+    const uint8_t itemLen = format == CRYPTO_ADDR_FORMAT_HASH ? CRYPTO_ADDR_HASH_LEN : ED25519_PK_LEN;
+
+    // Results that do not fit are requested again by the host, starting at the next index
+    const uint8_t maxCount = (ADDR_BATCH_REPLY_MAXLEN - 1) / itemLen;
+    if (count > maxCount) {
+        count = maxCount;
+    }
+
+    G_io_apdu_buffer[0] = count;
+    return 1 + crypto_fillAddressBatch(G_io_apdu_buffer + 1, ADDR_BATCH_REPLY_MAXLEN - 1,
+                                       path, count, format);
+}
+
 void app_reply_address() {
     const uint8_t replyLen = app_fill_address();
     set_code(G_io_apdu_buffer, replyLen, APDU_CODE_OK);
     io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, replyLen + 2);
 }
 
+void app_exit() {
+    // Do not leave key material behind
+    crypto_clearKeyCache();
+    os_sched_exit(-1);
+}
+
 void app_reply_error() {
     set_code(G_io_apdu_buffer, 0, APDU_CODE_DATA_INVALID);
     io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, 2);
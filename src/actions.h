@@ -18,12 +18,34 @@
 
 #include <stdint.h>
 
+// Batch signatures returned by a single APDU
+#define BATCH_SIGNATURES_PER_APDU   3
+
+// Largest answer to INS_GET_ADDR_BATCH_ED25519, without return code
+#define ADDR_BATCH_REPLY_MAXLEN     255
+
 uint8_t app_sign();
 
+uint8_t app_sign_batch();
+
+/// Copies up to BATCH_SIGNATURES_PER_APDU batch signatures, starting at first
+/// \return number of bytes written
+uint8_t app_fill_batch_signatures(uint8_t *buffer, uint8_t first);
+
+uint8_t app_get_batch_signatures_count();
+
+void app_clear_batch_signatures();
+
 void app_set_hrp(char *p);
 
 uint8_t app_fill_address();
 
+/// Puts the count of results and then as many results as fit in one APDU
+/// \return number of bytes written
+uint8_t app_fill_address_batch(const uint32_t *path, uint8_t count, uint8_t format);
+
 void app_reply_address();
 
 void app_reply_error();
+
+void app_exit();
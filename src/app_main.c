@@ -45,6 +45,8 @@ unsigned char io_event(unsigned char channel) {
             break;
 
         case SEPROXYHAL_TAG_TICKER_EVENT: { //
+            // Expire the cached key
+            crypto_tickKeyCache();
             UX_TICKER_EVENT(G_io_seproxyhal_spi_buffer, {
                 if (UX_ALLOWED) {
                     UX_REDISPLAY();
@@ -89,27 +91,31 @@ unsigned short io_exchange_al(unsigned char channel, unsigned short tx_len) {
     return 0;
 }
 
-void extractBip32(uint32_t rx, uint32_t offset) {
+void extractBip32Path(uint32_t path[BIP32_LEN_DEFAULT], uint32_t rx, uint32_t offset) {
     if ((rx - offset) < 4 * BIP32_LEN_DEFAULT) {
         THROW(APDU_CODE_DATA_INVALID);
     }
 
-    memcpy(bip32Path, G_io_apdu_buffer + offset, 4 * BIP32_LEN_DEFAULT);
+    memcpy(path, G_io_apdu_buffer + offset, 4 * BIP32_LEN_DEFAULT);
 
     // Check values
-    if (bip32Path[0] != BIP32_PATH_0 ||
-        bip32Path[1] != BIP32_PATH_1) {
+    if (path[0] != BIP32_PATH_0 ||
+        path[1] != BIP32_PATH_1) {
         THROW(APDU_CODE_DATA_INVALID);
     }
 
     // Check all items are hardened
     for (int i = 0; i < BIP32_LEN_DEFAULT; i++) {
-        if ( (bip32Path[i] & 0x80000000) == 0) {
+        if ( (path[i] & 0x80000000) == 0) {
             THROW(APDU_CODE_DATA_INVALID);
         }
     }
 }
 
+void extractBip32(uint32_t rx, uint32_t offset) {
+    extractBip32Path(bip32Path, rx, offset);
+}
+
 bool process_chunk(volatile uint32_t *tx, uint32_t rx, bool getBip32) {
     int packageIndex = G_io_apdu_buffer[OFFSET_PCK_INDEX];
     int packageCount = G_io_apdu_buffer[OFFSET_PCK_COUNT];
@@ -122,6 +128,7 @@ bool process_chunk(volatile uint32_t *tx, uint32_t rx, bool getBip32) {
     if (packageIndex == 1) {
         tx_initialize();
         tx_reset();
+        app_clear_batch_signatures();
 
         extractBip32(rx, OFFSET_DATA);
 
@@ -190,8 +197,67 @@ void handleApdu(volatile uint32_t *flags, volatile uint32_t *tx, uint32_t rx) {
                     break;
                 }
 
+                case INS_GET_ADDR_BATCH_ED25519: {
+                    // The active path is not modified
+                    uint32_t path[BIP32_LEN_DEFAULT];
+                    extractBip32Path(path, rx, OFFSET_DATA);
+
+                    if (rx < OFFSET_DATA + 4 * BIP32_LEN_DEFAULT + 1) {
+                        THROW(APDU_CODE_DATA_INVALID);
+                    }
+                    const uint8_t count = G_io_apdu_buffer[OFFSET_DATA + 4 * BIP32_LEN_DEFAULT];
+
+                    const uint8_t format = G_io_apdu_buffer[OFFSET_P1];
+                    if (format != CRYPTO_ADDR_FORMAT_PUBKEY && format != CRYPTO_ADDR_FORMAT_HASH) {
+                        THROW(APDU_CODE_INVALIDP1P2);
+                    }
+
+                    // Indexes must stay hardened
+                    const uint32_t lastIndex = path[BIP32_LEN_DEFAULT - 1] + count - 1;
+                    if (count == 0 || (lastIndex & 0x80000000) == 0) {
+                        THROW(APDU_CODE_DATA_INVALID);
+                    }
+
+                    *tx = app_fill_address_batch(path, count, format);
+                    THROW(APDU_CODE_OK);
+                    break;
+                }
+
                 case INS_SIGN_ED25519: {
-                    if (!process_chunk(tx, rx, true))
+#ifdef MAINNET_ENABLED
+                    const bool_t isMainnet = bool_true;
+#else
+                    const bool_t isMainnet = bool_false;
+#endif
+                    const char *error_msg = NULL;
+                    if (process_chunk(tx, rx, true)) {
+                        error_msg = tx_parse(isMainnet);
+                    } else {
+                        // Bad transactions are rejected without waiting for the remaining chunks
+                        error_msg = tx_check_partial(isMainnet);
+                        if (error_msg == NULL)
+                            THROW(APDU_CODE_OK);
+                    }
+
+                    if (error_msg != NULL) {
+                        int error_msg_length = strlen(error_msg);
+                        os_memmove(G_io_apdu_buffer, error_msg, error_msg_length);
+                        *tx += (error_msg_length);
+                        THROW(APDU_CODE_DATA_INVALID);
+                    }
+
+                    view_sign_show();
+                    *flags |= IO_ASYNCH_REPLY;
+                    break;
+                }
+
+                case INS_SIGN_BATCH_ED25519: {
+                    const bool lastChunk = process_chunk(tx, rx, true);
+                    if (G_io_apdu_buffer[OFFSET_PCK_INDEX] == 1) {
+                        tx_batch_begin();
+                    }
+
+                    if (!lastChunk)
                         THROW(APDU_CODE_OK);
 
 #ifdef MAINNET_ENABLED
@@ -199,7 +265,7 @@ void handleApdu(volatile uint32_t *flags, volatile uint32_t *tx, uint32_t rx) {
 #else
                     const bool_t isMainnet = bool_false;
 #endif
-                    const char *error_msg = tx_parse(isMainnet);
+                    const char *error_msg = tx_batch_parse(isMainnet);
 
                     if (error_msg != NULL) {
                         int error_msg_length = strlen(error_msg);
@@ -213,6 +279,17 @@ void handleApdu(volatile uint32_t *flags, volatile uint32_t *tx, uint32_t rx) {
                     break;
                 }
 
+                case INS_GET_BATCH_SIGNATURES: {
+                    const uint8_t first = G_io_apdu_buffer[OFFSET_P1];
+                    if (first >= app_get_batch_signatures_count()) {
+                        THROW(APDU_CODE_COMMAND_NOT_ALLOWED);
+                    }
+
+                    *tx = app_fill_batch_signatures(G_io_apdu_buffer, first);
+                    THROW(APDU_CODE_OK);
+                    break;
+                }
+
                 default:
                     THROW(APDU_CODE_INS_NOT_SUPPORTED);
             }
@@ -36,6 +36,9 @@
 #define INS_GET_VERSION                 0
 #define INS_GET_ADDR_ED25519            1
 #define INS_SIGN_ED25519                2
+#define INS_SIGN_BATCH_ED25519          3
+#define INS_GET_BATCH_SIGNATURES        4
+#define INS_GET_ADDR_BATCH_ED25519      5
 
 #define BIP32_PATH_0                    (0x80000000 | 0x2c)
 #define BIP32_PATH_1                    (0x80000000 | 0xea)
@@ -0,0 +1,40 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "arena.h"
+
+// Slots of a phase follow each other and must not overlap
+#define ARENA_CHECK_NEXT(OFFSET, SIZE, NEXT) \
+    _Static_assert((OFFSET) + (SIZE) <= (NEXT), #OFFSET " overlaps the next slot")
+
+ARENA_CHECK_NEXT(ARENA_DIGEST_CTX_OFFSET, ARENA_DIGEST_CTX_SIZE, ARENA_RECEIVE_SIZE);
+
+ARENA_CHECK_NEXT(ARENA_RENDER_OFFSET, ARENA_RENDER_SIZE, ARENA_VIEW_OFFSET);
+ARENA_CHECK_NEXT(ARENA_VIEW_OFFSET, ARENA_VIEW_SIZE, ARENA_REVIEW_SIZE);
+
+ARENA_CHECK_NEXT(0, ARENA_RECEIVE_SIZE, ARENA_SIZE);
+ARENA_CHECK_NEXT(0, ARENA_REVIEW_SIZE, ARENA_SIZE);
+
+uint8_t arena[ARENA_SIZE] __attribute__ ((aligned(8)));
+arena_phase_t arena_phase;
+
+void arena_enter(arena_phase_t phase) {
+    arena_phase = phase;
+}
+
+arena_phase_t arena_get_phase() {
+    return arena_phase;
+}
@@ -0,0 +1,76 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// Phase overlaid static memory
+// Buffers that are never live at the same time share the same RAM. Within a phase, buffers are laid
+// out one after the other so they never overlap; each owner checks at compile time that its type
+// fits the slot reserved for it (ARENA_CHECK).
+// Entering a phase ends the previous one: its buffers must be considered lost.
+
+typedef enum {
+    arena_phase_none = 0,
+    arena_phase_receive = 1,            // transaction chunks are received and hashed
+    arena_phase_review = 2,             // items are rendered and shown
+} arena_phase_t;
+
+// Receive phase
+#define ARENA_DIGEST_CTX_OFFSET     0
+#define ARENA_DIGEST_CTX_SIZE       332             // cx_sha512_t
+#define ARENA_RECEIVE_SIZE          (ARENA_DIGEST_CTX_OFFSET + ARENA_DIGEST_CTX_SIZE)
+
+// Review phase
+#define ARENA_RENDER_OFFSET         0
+#define ARENA_RENDER_SIZE           256             // render cache strings
+#define ARENA_VIEW_OFFSET           (ARENA_RENDER_OFFSET + ARENA_RENDER_SIZE)
+#if defined(TARGET_NANOX)
+#define ARENA_VIEW_SIZE             4163            // view_t
+#else
+#define ARENA_VIEW_SIZE             92              // view_t
+#endif
+#define ARENA_REVIEW_SIZE           (ARENA_VIEW_OFFSET + ARENA_VIEW_SIZE)
+
+#define ARENA_SIZE \
+    (ARENA_RECEIVE_SIZE > ARENA_REVIEW_SIZE ? ARENA_RECEIVE_SIZE : ARENA_REVIEW_SIZE)
+
+// RAM saved compared to giving each buffer its own memory
+#define ARENA_RECLAIMED             (ARENA_RECEIVE_SIZE + ARENA_REVIEW_SIZE - ARENA_SIZE)
+
+extern uint8_t arena[ARENA_SIZE];
+
+#define ARENA_AT(TYPE, OFFSET) ((TYPE *) (arena + (OFFSET)))
+
+// Slots are 8 byte aligned so any type can be placed in them
+#define ARENA_CHECK(TYPE, OFFSET, SIZE) \
+    _Static_assert(sizeof(TYPE) <= (SIZE) && (OFFSET) % 8 == 0, #TYPE " does not fit its arena slot")
+
+/// Start using the buffers of a phase, the buffers of any other phase are lost
+/// \param phase
+void arena_enter(arena_phase_t phase);
+
+/// Phase whose buffers are currently valid
+/// \return
+arena_phase_t arena_get_phase();
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,61 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include <zxmacros.h>
+#include "chain.h"
+#include "iov.h"
+
+const chain_t chain_registry[CHAIN_COUNT] = {
+        {0, 0, "", APP_TESTNET_HRP, CHAIN_FLAG_SHOW_ID},
+        {0xB86D18C8, APP_MAINNET_CHAINID_LEN, APP_MAINNET_CHAINID, APP_MAINNET_HRP, CHAIN_FLAG_MAINNET},
+        {0x2C566363, 11, "iov-lovenet", APP_TESTNET_HRP, CHAIN_FLAG_SHOW_ID},
+};
+
+const uint8_t chain_slots[CHAIN_SLOTS] = {
+        CHAIN_IOV_MAINNET,          // 0xB86D18C8
+        CHAIN_OTHER_TESTNET,
+        CHAIN_OTHER_TESTNET,
+        CHAIN_IOV_LOVENET,          // 0x2C566363
+};
+
+uint32_t chain_hash(const uint8_t *chainID, uint16_t chainIDLen) {
+    uint32_t hash = 0x811C9DC5u;
+    for (uint16_t i = 0; i < chainIDLen; i++) {
+        hash ^= chainID[i];
+        hash *= 0x01000193u;
+    }
+    return hash;
+}
+
+uint8_t chain_lookup(const uint8_t *chainID, uint16_t chainIDLen) {
+    const uint32_t hash = chain_hash(chainID, chainIDLen);
+    const uint8_t idx = chain_slots[hash & (CHAIN_SLOTS - 1)];
+    const chain_t *chain = &chain_registry[idx];
+
+    // A single candidate, it must match exactly
+    if (idx == CHAIN_OTHER_TESTNET || chain->hash != hash || chain->chainIDLen != chainIDLen ||
+        MEMCMP(chain->chainID, chainID, chainIDLen) != 0) {
+        return CHAIN_OTHER_TESTNET;
+    }
+    return idx;
+}
+
+const chain_t *chain_get(uint8_t idx) {
+    if (idx >= CHAIN_COUNT) {
+        idx = CHAIN_OTHER_TESTNET;
+    }
+    return &chain_registry[idx];
+}
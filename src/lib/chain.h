@@ -0,0 +1,71 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// Chain registry
+// Chains known at compile time, with the HRP of their addresses and how their transactions are shown.
+// The chain ID of a transaction is looked up once when its header is parsed, see chain_lookup.
+// Chains that are not registered are handled as testnets.
+
+#define CHAIN_FLAG_MAINNET      0x01u   // signed by mainnet builds only
+#define CHAIN_FLAG_SHOW_ID      0x02u   // the chain ID is shown for review
+
+#define CHAIN_ID_MAXLEN         16      // of registered chains
+#define CHAIN_HRP_MAXLEN        4
+
+// Registry entries
+#define CHAIN_OTHER_TESTNET     0
+#define CHAIN_IOV_MAINNET       1
+#define CHAIN_IOV_LOVENET       2
+#define CHAIN_COUNT             3
+
+// Lookup table, indexed by the low bits of the hash
+// Registered chains must land in different slots, check chain_hash when adding one
+#define CHAIN_SLOTS             4
+
+typedef struct {
+    uint32_t hash;                      // chain_hash of the chain ID
+    uint8_t chainIDLen;
+    char chainID[CHAIN_ID_MAXLEN];
+    char hrp[CHAIN_HRP_MAXLEN + 1];
+    uint8_t flags;                      // CHAIN_FLAG_*
+} chain_t;
+
+/// FNV-1a hash of a chain ID
+/// \param chainID
+/// \param chainIDLen
+/// \return
+uint32_t chain_hash(const uint8_t *chainID, uint16_t chainIDLen);
+
+/// Registry entry of a chain ID
+/// \param chainID
+/// \param chainIDLen
+/// \return CHAIN_OTHER_TESTNET if the chain is not registered
+uint8_t chain_lookup(const uint8_t *chainID, uint16_t chainIDLen);
+
+/// \param idx CHAIN_*, out of range values give CHAIN_OTHER_TESTNET
+/// \return
+const chain_t *chain_get(uint8_t idx);
+
+#ifdef __cplusplus
+}
+#endif
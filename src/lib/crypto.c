@@ -16,6 +16,7 @@
 
 #include "crypto.h"
 #include "iov.h"
+#include "arena.h"
 #include <bech32.h>
 
 uint32_t bip32Path[BIP32_LEN_DEFAULT];
@@ -23,59 +24,133 @@ uint32_t bip32Path[BIP32_LEN_DEFAULT];
 #if defined(TARGET_NANOS) || defined(TARGET_NANOX)
 #include "cx.h"
 
-void crypto_extractPublicKey(uint32_t bip32Path[BIP32_LEN_DEFAULT], uint8_t *pubKey) {
+void crypto_generatePublicKey(const uint8_t *privateKeyData, uint8_t *pubKey) {
     cx_ecfp_public_key_t cx_publicKey;
     cx_ecfp_private_key_t cx_privateKey;
+
+    cx_ecfp_init_private_key(CX_CURVE_Ed25519, (uint8_t *) privateKeyData, 32, &cx_privateKey);
+    cx_ecfp_init_public_key(CX_CURVE_Ed25519, NULL, 0, &cx_publicKey);
+    cx_ecfp_generate_pair(CX_CURVE_Ed25519, &cx_publicKey, &cx_privateKey, 1);
+    MEMSET(&cx_privateKey, 0, sizeof(cx_privateKey));
+
+    // Format pubkey
+    for (int i = 0; i < 32; i++) {
+        pubKey[i] = cx_publicKey.W[64 - i];
+    }
+
+    if ((cx_publicKey.W[32] & 1) != 0) {
+        pubKey[31] |= 0x80;
+    }
+}
+
+void crypto_computePublicKey(const uint32_t path[BIP32_LEN_DEFAULT], uint8_t *pubKey) {
+    // Bypasses the key cache on purpose: scanned keys are used once and must not
+    // evict the key of the account in use, nor stay in RAM after the scan
     uint8_t privateKeyData[32];
 
-    // Generate keys
     os_perso_derive_node_bip32_seed_key(
             HDW_ED25519_SLIP10,
             CX_CURVE_Ed25519,
-            bip32Path,
+            (uint32_t *) path,
             BIP32_LEN_DEFAULT,
             privateKeyData,
             NULL,
             NULL,
             0);
 
-    cx_ecfp_init_private_key(CX_CURVE_Ed25519, privateKeyData, 32, &cx_privateKey);
-    cx_ecfp_init_public_key(CX_CURVE_Ed25519, NULL, 0, &cx_publicKey);
-    cx_ecfp_generate_pair(CX_CURVE_Ed25519, &cx_publicKey, &cx_privateKey, 1);
+    crypto_generatePublicKey(privateKeyData, pubKey);
     MEMSET(privateKeyData, 0, 32);
+}
 
-    // Format pubkey
-    for (int i = 0; i < 32; i++) {
-        pubKey[i] = cx_publicKey.W[64 - i];
-    }
+// Key cache
+// Derived key material for the last used path. The entry expires after a fixed lifetime,
+// is zeroized before another path is derived and when the app exits
+typedef struct {
+    uint32_t path[BIP32_LEN_DEFAULT];
+    uint8_t privateKeyData[32];
+    uint8_t pubKey[ED25519_PK_LEN];
+    uint16_t ttl;                       // remaining ticks, zero means empty
+    bool_t pubKeyValid;
+} crypto_key_cache_entry_t;
 
-    if ((cx_publicKey.W[32] & 1) != 0) {
-        pubKey[31] |= 0x80;
+crypto_key_cache_entry_t key_cache;
+
+void crypto_clearKeyCache() {
+    MEMSET(&key_cache, 0, sizeof(crypto_key_cache_entry_t));
+}
+
+void crypto_tickKeyCache() {
+    if (key_cache.ttl == 0) {
+        return;
+    }
+    key_cache.ttl--;
+    if (key_cache.ttl == 0) {
+        crypto_clearKeyCache();
     }
 }
 
-uint16_t crypto_sign(uint8_t *signature, uint16_t signatureMaxlen, const uint8_t *message, uint16_t messageLen) {
-    // Hash
-    uint8_t messageDigest[CX_SHA512_SIZE];
-    cx_hash_sha512(message, messageLen, messageDigest, CX_SHA512_SIZE);
+crypto_key_cache_entry_t *crypto_getKey(const uint32_t path[BIP32_LEN_DEFAULT]) {
+    if (key_cache.ttl != 0 &&
+        os_memcmp(key_cache.path, path, sizeof(key_cache.path)) == 0) {
+        return &key_cache;
+    }
+
+    // Only one key is ever kept in RAM
+    crypto_clearKeyCache();
 
     // Generate keys
-    cx_ecfp_private_key_t cx_privateKey;
-    uint8_t privateKeyData[32];
     os_perso_derive_node_bip32_seed_key(
             HDW_ED25519_SLIP10,
             CX_CURVE_Ed25519,
-            bip32Path,
+            (uint32_t *) path,
             BIP32_LEN_DEFAULT,
-            privateKeyData,
+            key_cache.privateKeyData,
             NULL,
             NULL,
             0);
-    cx_ecfp_init_private_key(CX_CURVE_Ed25519, privateKeyData, 32, &cx_privateKey);
 
-    // Sign
+    MEMCPY(key_cache.path, path, sizeof(key_cache.path));
+    key_cache.ttl = CRYPTO_KEY_CACHE_TTL;
+    return &key_cache;
+}
+
+void crypto_extractPublicKey(uint32_t bip32Path[BIP32_LEN_DEFAULT], uint8_t *pubKey) {
+    crypto_key_cache_entry_t *entry = crypto_getKey(bip32Path);
+
+    if (!entry->pubKeyValid) {
+        crypto_generatePublicKey(entry->privateKeyData, entry->pubKey);
+        entry->pubKeyValid = bool_true;
+    }
+
+    MEMCPY(pubKey, entry->pubKey, ED25519_PK_LEN);
+}
+
+void crypto_derivePrivateKey(cx_ecfp_private_key_t *cx_privateKey) {
+    crypto_key_cache_entry_t *entry = crypto_getKey(bip32Path);
+    cx_ecfp_init_private_key(CX_CURVE_Ed25519, entry->privateKeyData, 32, cx_privateKey);
+}
+
+// Digest of the message being received, kept in the receive phase of the arena
+#define crypto_digestCtx (*ARENA_AT(cx_sha512_t, ARENA_DIGEST_CTX_OFFSET))
+ARENA_CHECK(cx_sha512_t, ARENA_DIGEST_CTX_OFFSET, ARENA_DIGEST_CTX_SIZE);
+
+void crypto_digestInit() {
+    cx_sha512_init(&crypto_digestCtx);
+}
+
+void crypto_digestUpdate(const uint8_t *data, uint16_t len) {
+    cx_hash(&crypto_digestCtx.header, 0, data, len, NULL, 0);
+}
+
+void crypto_digestFinal(uint8_t *digest) {
+    cx_hash(&crypto_digestCtx.header, CX_LAST, NULL, 0, digest, CX_SHA512_SIZE);
+}
+
+uint16_t crypto_signDigestWithKey(cx_ecfp_private_key_t *cx_privateKey,
+                                  uint8_t *signature, uint16_t signatureMaxlen,
+                                  const uint8_t *messageDigest) {
     unsigned int info = 0;
-    int signatureLength = cx_eddsa_sign(&cx_privateKey,
+    int signatureLength = cx_eddsa_sign(cx_privateKey,
                                         CX_LAST,
                                         CX_SHA512,
                                         messageDigest,
@@ -86,22 +161,126 @@ uint16_t crypto_sign(uint8_t *signature, uint16_t signatureMaxlen, const uint8_t
                                         signatureMaxlen,
                                         &info);
 
+    return signatureLength;
+}
+
+uint16_t crypto_signWithKey(cx_ecfp_private_key_t *cx_privateKey,
+                            uint8_t *signature, uint16_t signatureMaxlen,
+                            const segments_t *message) {
+    // Hash both segments
+    uint8_t messageDigest[CX_SHA512_SIZE];
+    cx_sha512_t ctx;
+    cx_sha512_init(&ctx);
+    cx_hash(&ctx.header, 0, message->head, message->headLen, NULL, 0);
+    cx_hash(&ctx.header, CX_LAST, message->tail, message->tailLen, messageDigest, CX_SHA512_SIZE);
+
+    return crypto_signDigestWithKey(cx_privateKey, signature, signatureMaxlen, messageDigest);
+}
+
+uint16_t crypto_sign(uint8_t *signature, uint16_t signatureMaxlen, const segments_t *message) {
+    // Generate keys
+    cx_ecfp_private_key_t cx_privateKey;
+    crypto_derivePrivateKey(&cx_privateKey);
+
+    const uint16_t signatureLength = crypto_signWithKey(&cx_privateKey,
+                                                        signature, signatureMaxlen,
+                                                        message);
+
     MEMSET(&cx_privateKey, 0, sizeof(cx_privateKey));
-    MEMSET(privateKeyData, 0, 32);
 
     return signatureLength;
 }
+
+uint16_t crypto_signDigest(uint8_t *signature, uint16_t signatureMaxlen, const uint8_t *digest) {
+    cx_ecfp_private_key_t cx_privateKey;
+    crypto_derivePrivateKey(&cx_privateKey);
+
+    const uint16_t signatureLength = crypto_signDigestWithKey(&cx_privateKey,
+                                                              signature, signatureMaxlen,
+                                                              digest);
+
+    MEMSET(&cx_privateKey, 0, sizeof(cx_privateKey));
+
+    return signatureLength;
+}
+
+uint8_t crypto_signBatch(uint8_t *signatures, uint16_t signaturesMaxlen,
+                         crypto_message_getter_t getMessage, uint8_t count) {
+    if (signaturesMaxlen < count * ED25519_SIGNATURE_LEN) {
+        return 0;
+    }
+
+    // Keys are derived once for the whole batch
+    cx_ecfp_private_key_t cx_privateKey;
+    crypto_derivePrivateKey(&cx_privateKey);
+
+    uint8_t signed_count = 0;
+    for (; signed_count < count; signed_count++) {
+        segments_t message;
+        if (!getMessage(signed_count, &message)) {
+            break;
+        }
+
+        const uint16_t signatureLength = crypto_signWithKey(&cx_privateKey,
+                                                            signatures + signed_count * ED25519_SIGNATURE_LEN,
+                                                            ED25519_SIGNATURE_LEN,
+                                                            &message);
+        if (signatureLength != ED25519_SIGNATURE_LEN) {
+            break;
+        }
+    }
+
+    MEMSET(&cx_privateKey, 0, sizeof(cx_privateKey));
+
+    return signed_count;
+}
 #else
 
+void crypto_clearKeyCache() {
+    // Empty version for non-Ledger devices
+}
+
+void crypto_tickKeyCache() {
+    // Empty version for non-Ledger devices
+}
+
 void crypto_extractPublicKey(uint32_t path[BIP32_LEN_DEFAULT], uint8_t *pubKey) {
     // Empty version for non-Ledger devices
     MEMSET(pubKey, 0, 32);
 }
 
+void crypto_computePublicKey(const uint32_t path[BIP32_LEN_DEFAULT], uint8_t *pubKey) {
+    // Empty version for non-Ledger devices
+    MEMSET(pubKey, 0, 32);
+}
+
+void crypto_digestInit() {
+    // Empty version for non-Ledger devices
+}
+
+void crypto_digestUpdate(const uint8_t *data, uint16_t len) {
+    // Empty version for non-Ledger devices
+}
+
+void crypto_digestFinal(uint8_t *digest) {
+    // Empty version for non-Ledger devices
+    MEMSET(digest, 0, CRYPTO_DIGEST_LEN);
+}
+
 uint16_t crypto_sign(uint8_t *signature,
                      uint16_t signatureMaxlen,
-                     const uint8_t *message,
-                     uint16_t messageLen) {
+                     const segments_t *message) {
+    // Empty version for non-Ledger devices
+    return 0;
+}
+
+uint16_t crypto_signDigest(uint8_t *signature, uint16_t signatureMaxlen, const uint8_t *digest) {
+    // Empty version for non-Ledger devices
+    return 0;
+}
+
+uint8_t crypto_signBatch(uint8_t *signatures, uint16_t signaturesMaxlen,
+                         crypto_message_getter_t getMessage, uint8_t count) {
     // Empty version for non-Ledger devices
     return 0;
 }
@@ -122,6 +301,15 @@ void crypto_set_hrp(char *p) {
     hrp = p;
 }
 
+void crypto_addressHash(const uint8_t *pubKey, uint8_t *hash) {
+    char tmp[IOV_PK_PREFIX_LEN + ED25519_PK_LEN];
+    strcpy(tmp, IOV_PK_PREFIX);
+    MEMCPY(tmp + IOV_PK_PREFIX_LEN, pubKey, ED25519_PK_LEN);
+
+    cx_hash_sha256((uint8_t *) tmp, IOV_PK_PREFIX_LEN + ED25519_PK_LEN,
+                   hash, CX_SHA256_SIZE);
+}
+
 uint16_t crypto_fillAddress(uint8_t *buffer, uint16_t buffer_len) {
     if (buffer_len < ED25519_PK_LEN + 30) {
         return 0;
@@ -130,16 +318,41 @@ uint16_t crypto_fillAddress(uint8_t *buffer, uint16_t buffer_len) {
     // extract pubkey (first 32 bytes)
     crypto_extractPublicKey(bip32Path, buffer);
 
-    char tmp[IOV_PK_PREFIX_LEN + ED25519_PK_LEN];
-    strcpy(tmp, IOV_PK_PREFIX);
-    MEMCPY(tmp + IOV_PK_PREFIX_LEN, buffer, ED25519_PK_LEN);
-
-    //
     uint8_t hash[CX_SHA256_SIZE];
-    cx_hash_sha256((uint8_t *) tmp, IOV_PK_PREFIX_LEN + ED25519_PK_LEN,
-                   hash, CX_SHA256_SIZE);
+    crypto_addressHash(buffer, hash);
 
     char *addr = (char *) (buffer + ED25519_PK_LEN);
-    bech32EncodeFromBytes(addr, hrp, hash, 20);
+    bech32EncodeFromBytes20(addr, hrp, hash);
     return ED25519_PK_LEN + strlen(addr);
 }
+
+uint16_t crypto_fillAddressBatch(uint8_t *buffer, uint16_t buffer_len,
+                                 const uint32_t path[BIP32_LEN_DEFAULT],
+                                 uint8_t count, uint8_t format) {
+    const uint16_t itemLen = format == CRYPTO_ADDR_FORMAT_HASH ? CRYPTO_ADDR_HASH_LEN : ED25519_PK_LEN;
+    if (buffer_len < count * itemLen) {
+        return 0;
+    }
+
+    uint32_t p[BIP32_LEN_DEFAULT];
+    MEMCPY(p, path, sizeof(p));
+
+    uint8_t pubKey[ED25519_PK_LEN];
+    uint8_t hash[CX_SHA256_SIZE];
+    for (uint8_t i = 0; i < count; i++) {
+        crypto_computePublicKey(p, pubKey);
+
+        if (format == CRYPTO_ADDR_FORMAT_HASH) {
+            // bech32 formatting is left to the host
+            crypto_addressHash(pubKey, hash);
+            MEMCPY(buffer, hash, CRYPTO_ADDR_HASH_LEN);
+        } else {
+            MEMCPY(buffer, pubKey, ED25519_PK_LEN);
+        }
+
+        buffer += itemLen;
+        p[BIP32_LEN_DEFAULT - 1]++;
+    }
+
+    return count * itemLen;
+}
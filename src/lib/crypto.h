@@ -17,6 +17,7 @@
 #pragma once
 
 #include <zxmacros.h>
+#include "iov.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,17 +25,67 @@ extern "C" {
 
 #define BIP32_LEN_DEFAULT 3
 #define ED25519_PK_LEN 32
+#define ED25519_SIGNATURE_LEN 64
+#define CRYPTO_DIGEST_LEN 64
+
+// Address hash, encoded as bech32 to obtain the address
+#define CRYPTO_ADDR_HASH_LEN 20
+
+// Output formats for crypto_fillAddressBatch
+#define CRYPTO_ADDR_FORMAT_PUBKEY 0
+#define CRYPTO_ADDR_FORMAT_HASH   1
+
+/// Returns the message to sign at position idx of a batch
+typedef bool_t (*crypto_message_getter_t)(uint8_t idx, segments_t *message);
+
+// The derived key of the last used path is kept, see crypto_getKey
+// Lifetime of a derived key in UX ticker events (100 ms each)
+#define CRYPTO_KEY_CACHE_TTL 300
 
 extern uint32_t bip32Path[BIP32_LEN_DEFAULT];
 extern char *hrp;
 
+/// Zeroizes the cached key
+void crypto_clearKeyCache();
+
+/// Ages the cached key, must be called on every UX ticker event
+void crypto_tickKeyCache();
+
 void crypto_extractPublicKey(uint32_t bip32Path[BIP32_LEN_DEFAULT], uint8_t *pubKey);
 
 void crypto_set_hrp(char *p);
 
 uint16_t crypto_fillAddress(uint8_t *buffer, uint16_t buffer_len);
 
-uint16_t crypto_sign(uint8_t *signature, uint16_t signatureMaxlen, const uint8_t *message, uint16_t messageLen);
+/// Fills buffer with the pubkeys or address hashes of count consecutive paths
+/// The last path component is incremented for every item. Derived keys are not cached
+/// \return number of bytes written
+uint16_t crypto_fillAddressBatch(uint8_t *buffer, uint16_t buffer_len,
+                                 const uint32_t path[BIP32_LEN_DEFAULT],
+                                 uint8_t count, uint8_t format);
+
+/// Starts a SHA-512 digest of a message that is received in chunks
+void crypto_digestInit();
+
+/// Adds a chunk to the digest
+void crypto_digestUpdate(const uint8_t *data, uint16_t len);
+
+/// Completes the digest
+/// \param digest CRYPTO_DIGEST_LEN bytes
+void crypto_digestFinal(uint8_t *digest);
+
+/// Signs a message that may be split in two segments
+uint16_t crypto_sign(uint8_t *signature, uint16_t signatureMaxlen, const segments_t *message);
+
+/// Signs a message from its SHA-512 digest, so that no pass over the message is needed
+/// \param digest CRYPTO_DIGEST_LEN bytes, see crypto_digestFinal
+uint16_t crypto_signDigest(uint8_t *signature, uint16_t signatureMaxlen, const uint8_t *digest);
+
+/// Signs count messages with a single key derivation
+/// Signatures are written back to back, ED25519_SIGNATURE_LEN bytes each
+/// \return number of messages that have been signed
+uint8_t crypto_signBatch(uint8_t *signatures, uint16_t signaturesMaxlen,
+                         crypto_message_getter_t getMessage, uint8_t count);
 
 #ifdef __cplusplus
 }
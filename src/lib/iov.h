@@ -27,6 +27,14 @@ typedef enum {
     bool_true = 1,
 } bool_t;
 
+// Bytes split in two segments (e.g. RAM followed by flash). The tail is empty for contiguous data
+typedef struct {
+    const uint8_t *head;
+    uint16_t headLen;
+    const uint8_t *tail;
+    uint16_t tailLen;
+} segments_t;
+
 #define APP_MAINNET_HRP          "iov"
 #define APP_MAINNET_CHAINID      "iov-mainnet"
 #define APP_MAINNET_CHAINID_LEN   11
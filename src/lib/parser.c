@@ -17,6 +17,8 @@
 #include <stdio.h>
 #include <zxmacros.h>
 #include "parser.h"
+#include "arena.h"
+#include "chain.h"
 #include "iov.h"
 
 #ifdef MAINNET_ENABLED
@@ -39,50 +41,381 @@
 #define FIELD_MEMO 5
 #endif
 
+#define FIELD_MULTISIG (FIELD_MEMO + 1)
+
+// Multisig entries are not indexed, they follow the other items
+#define DISPLAY_ITEMS_MAX FIELD_TOTAL_FIXCOUNT
+
+// Display indexes are signed 8 bit values
+_Static_assert(DISPLAY_ITEMS_MAX + PBIDX_MULTISIG_COUNT_MAX <= INT8_MAX, "Too many display items");
+
 // * optional chainid for testnet mode
 // 0  source
 // 1  destination
 // 2  amount  value / ticker
 // 3  fees  value / ticker
 // 4  memo                      (when exists)
+// *  multisig                  (one per entry)
+
+#define UI_BUFFER ARENA_RENDER_SIZE
+
+// Render cache
+// Addresses and memo are rendered once per parsed transaction and pages are served as slices of the
+// cached string. When an item does not fit in the free space, the cache is dropped and reused from the start
+// Strings are kept in the review phase of the arena, the bookkeeping is not, so the cache can be
+// dropped while chunks are received without touching the receive phase buffers
+#define RENDER_SLOT_SOURCE          0
+#define RENDER_SLOT_DESTINATION     1
+#define RENDER_SLOT_MEMO            2
+#define RENDER_SLOT_COUNT           3
+
+#define RENDER_BECH32_MAXLEN        90      // longer bech32 strings are not encoded
+
+typedef struct {
+    uint8_t valid;                          // bitmask of rendered slots
+    uint16_t used;
+    uint16_t offset[RENDER_SLOT_COUNT];
+} parser_render_cache_t;
+
+parser_render_cache_t render_cache;
+#define render_buffer ARENA_AT(char, ARENA_RENDER_OFFSET)
+
+// Display index
+// Built once the tx has been validated, maps each display index to the field it shows
+typedef struct {
+    int8_t field;                           // FIELD_*
+    uint8_t arg;                            // multisig entry
+    uint8_t valueLen;                       // length of the paged value
+} parser_display_item_t;
 
-#define UI_BUFFER 256
+typedef struct {
+    uint8_t count;
+    uint8_t multisigCount;                  // one item per entry after the indexed items
+    parser_display_item_t items[DISPLAY_ITEMS_MAX];
+} parser_display_index_t;
+
+parser_display_index_t display_index;
+
+parser_error_t parser_renderItem(uint8_t slot, const char **rendered);
+
+#define CHECK_PARSER_ERR(CALL) { parser_error_t err = CALL; if (err != parser_ok) return err; }
+
+void parser_resetRenderCache() {
+    render_cache.valid = 0;
+    render_cache.used = 0;
+}
+
+void parser_resetDisplay() {
+    display_index.count = 0;
+    display_index.multisigCount = 0;
+    parser_resetRenderCache();
+}
 
 parser_error_t parser_parse(parser_context_t *ctx,
                             uint8_t *data,
                             uint16_t dataLen) {
+    parser_resetDisplay();
     parser_init(ctx, data, dataLen);
     return parser_Tx(ctx);
 }
 
-parser_error_t parser_validate(bool_t isMainnet) {
-    if (isMainnet != parser_IsMainnet(parser_tx_obj.chainID, parser_tx_obj.chainIDLen)) {
+parser_error_t parser_parseIncremental(parser_context_t *ctx,
+                                       const uint8_t *data,
+                                       uint16_t dataLen,
+                                       bool_t partial) {
+    parser_resetDisplay();
+
+    if (ctx->buffer != data || dataLen < ctx->bufferSize) {
+        // Buffer has been reset or moved (e.g. from RAM to flash), start over
+        parser_error_t err = parser_init(ctx, data, dataLen);
+        if (err != parser_ok) {
+            return err;
+        }
+    }
+
+    parser_setContextSize(ctx, dataLen);
+    ctx->partial = partial;
+    return parser_Tx(ctx);
+}
+
+parser_error_t parser_parseChunk(parser_context_t *ctx,
+                                 const uint8_t *data,
+                                 uint16_t dataLen) {
+    parser_error_t err = parser_parseIncremental(ctx, data, dataLen, bool_true);
+    if (err == parser_no_data) {
+        // Nothing has been received yet
+        return parser_ok;
+    }
+    return err;
+}
+
+parser_error_t parser_parseEnd(parser_context_t *ctx,
+                               const uint8_t *data,
+                               uint16_t dataLen) {
+    return parser_parseIncremental(ctx, data, dataLen, bool_false);
+}
+
+parser_error_t parser_addDisplayItem(int8_t field, uint8_t arg) {
+    if (display_index.count >= DISPLAY_ITEMS_MAX) {
+        return parser_value_out_of_range;
+    }
+
+    parser_display_item_t *item = &display_index.items[display_index.count];
+    item->field = field;
+    item->arg = arg;
+    item->valueLen = 0;
+
+    // Lengths of paged values are known without rendering them, so page counts are known in advance
+    switch (field) {
+        case FIELD_CHAINID:
+            item->valueLen = parser_tx_obj.chainIDLen;
+            break;
+        case FIELD_SOURCE:
+            item->valueLen = parser_addressLen(&parser_tx_obj.sendmsg.source);
+            break;
+        case FIELD_DESTINATION:
+            item->valueLen = parser_addressLen(&parser_tx_obj.sendmsg.destination);
+            break;
+        case FIELD_MEMO: {
+            const parser_span_t *memo = &parser_tx_obj.sendmsg.memo;
+            const uint8_t *ptr;
+            CHECK_PARSER_ERR(parser_getSpan(memo, &ptr))
+            item->valueLen = asciify_n_len((const char *) ptr, memo->len);
+            break;
+        }
+        default:
+            break;
+    }
+
+    display_index.count++;
+    return parser_ok;
+}
+
+parser_error_t parser_buildDisplayIndex() {
+    display_index.count = 0;
+    display_index.multisigCount = 0;
+
+    if (chain_get(parser_tx_obj.chain)->flags & CHAIN_FLAG_SHOW_ID) {
+        CHECK_PARSER_ERR(parser_addDisplayItem(FIELD_CHAINID, 0))
+    }
+    CHECK_PARSER_ERR(parser_addDisplayItem(FIELD_SOURCE, 0))
+    CHECK_PARSER_ERR(parser_addDisplayItem(FIELD_DESTINATION, 0))
+    CHECK_PARSER_ERR(parser_addDisplayItem(FIELD_AMOUNT, 0))
+    CHECK_PARSER_ERR(parser_addDisplayItem(FIELD_FEE, 0))
+    if (parser_tx_obj.sendmsg.memo.len != 0) {
+        CHECK_PARSER_ERR(parser_addDisplayItem(FIELD_MEMO, 0))
+    }
+    display_index.multisigCount = parser_tx_obj.multisig.count;
+
+    return parser_ok;
+}
+
+parser_error_t parser_validateChain(bool_t isMainnet) {
+    const bool_t chainIsMainnet = (chain_get(parser_tx_obj.chain)->flags & CHAIN_FLAG_MAINNET) ? bool_true : bool_false;
+    if (isMainnet != chainIsMainnet) {
         return parser_unexpected_chain;
     }
+    return parser_ok;
+}
 
-    if (parser_tx_obj.sendmsg.memoLen > TX_MEMOLEN_MAX) {
+parser_error_t parser_validateHeader(const parser_context_t *ctx, bool_t isMainnet) {
+    if (ctx->offset == 0) {
+        // The header is consumed at once, nothing has been read yet
+        return parser_ok;
+    }
+    return parser_validateChain(isMainnet);
+}
+
+parser_error_t parser_validate(bool_t isMainnet) {
+    display_index.count = 0;
+    display_index.multisigCount = 0;
+
+    parser_error_t err = parser_validateChain(isMainnet);
+    if (err != parser_ok) {
+        return err;
+    }
+
+    if (parser_tx_obj.sendmsg.memo.len > TX_MEMOLEN_MAX) {
         return parser_unexpected_buffer_end;
     }
 
-    return parser_ok;
+    return parser_buildDisplayIndex();
 }
 
 uint8_t parser_getNumItems(parser_context_t *ctx) {
-    uint8_t fields = FIELD_TOTAL_FIXCOUNT;
-    fields += parser_tx_obj.multisig.count;
-    if (parser_tx_obj.sendmsg.memoLen == 0)
-        fields--;
-    return fields;
+    return display_index.count + display_index.multisigCount;
+}
+
+bool_t parser_isPaged(int8_t field) {
+    switch (field) {
+        case FIELD_CHAINID:
+        case FIELD_SOURCE:
+        case FIELD_DESTINATION:
+        case FIELD_MEMO:
+            return bool_true;
+        default:
+            return bool_false;
+    }
+}
+
+char *parser_reserveRenderSlot(uint8_t slot, uint16_t maxLen) {
+    if (render_cache.used + maxLen > UI_BUFFER) {
+        // Not enough room, drop previous items
+        parser_resetRenderCache();
+    }
+
+    // Renderers terminate what they write, the slot is not cleared
+    char *out = render_buffer + render_cache.used;
+    out[0] = 0;
+    render_cache.offset[slot] = render_cache.used;
+    return out;
+}
+
+void parser_commitRenderSlot(uint8_t slot) {
+    const char *out = render_buffer + render_cache.offset[slot];
+    render_cache.used += strlen(out) + 1;
+    render_cache.valid |= 1u << slot;
+}
+
+uint8_t parser_addressLen(const parser_span_t *address) {
+    // hrp, separator, 5 bit values (bits that do not fill a last value are dropped) and checksum
+    const uint16_t encodedLen = strlen(parser_getHRP()) + 1 + address->len * 8 / 5 + 6;
+    if (encodedLen > RENDER_BECH32_MAXLEN) {
+        return 0;
+    }
+    return encodedLen;
+}
+
+parser_error_t parser_renderAddress(uint8_t slot, const parser_span_t *address) {
+    const uint8_t *ptr;
+    CHECK_PARSER_ERR(parser_getSpan(address, &ptr))
+
+    // Reserve the exact encoded length so several items can share the cache
+    const uint16_t encodedLen = parser_addressLen(address);
+
+    uint16_t outLen = IOV_ADDR_MAXLEN;
+    if (encodedLen + 1 > outLen) {
+        outLen = encodedLen + 1;
+    }
+
+    char *out = parser_reserveRenderSlot(slot, outLen);
+    parser_error_t err = parser_getAddress(parser_getHRP(),
+                                           out, outLen,
+                                           ptr, address->len);
+    if (err != parser_ok) {
+        return err;
+    }
+
+    parser_commitRenderSlot(slot);
+    return parser_ok;
+}
+
+parser_error_t parser_renderMemo() {
+    const parser_span_t *memo = &parser_tx_obj.sendmsg.memo;
+    const uint8_t *ptr;
+    CHECK_PARSER_ERR(parser_getSpan(memo, &ptr))
+
+    // asciify never makes the memo longer
+    const uint16_t outLen = (uint8_t) memo->len + 1;
+
+    char *out = parser_reserveRenderSlot(RENDER_SLOT_MEMO, outLen);
+    // Sanitized while it is copied
+    asciify_n((const char *) ptr, memo->len, out);
+    parser_commitRenderSlot(RENDER_SLOT_MEMO);
+    return parser_ok;
 }
 
-uint8_t UI_buffer[UI_BUFFER];
+parser_error_t parser_renderItem(uint8_t slot, const char **rendered) {
+    parser_error_t err = parser_ok;
 
-int8_t parser_mapDisplayIdx(parser_context_t *ctx, int8_t displayIdx) {
-    if (parser_tx_obj.sendmsg.memoLen == 0 && displayIdx >= FIELD_MEMO) {
-        // SKIP Memo Field
-        return displayIdx + 1;
+    if (!(render_cache.valid & (1u << slot))) {
+        switch (slot) {
+            case RENDER_SLOT_SOURCE:
+                err = parser_renderAddress(slot, &parser_tx_obj.sendmsg.source);
+                break;
+            case RENDER_SLOT_DESTINATION:
+                err = parser_renderAddress(slot, &parser_tx_obj.sendmsg.destination);
+                break;
+            case RENDER_SLOT_MEMO:
+                err = parser_renderMemo();
+                break;
+            default:
+                return parser_no_data;
+        }
     }
-    return displayIdx;
+
+    *rendered = render_buffer + render_cache.offset[slot];
+    return err;
+}
+
+parser_error_t parser_getRenderedItem(uint8_t slot,
+                                      char *outValue, uint16_t outValueLen,
+                                      uint8_t pageIdx, uint8_t *pageCount) {
+    const char *rendered;
+    parser_error_t err = parser_renderItem(slot, &rendered);
+
+    // page it
+    parser_arrayToString(outValue, outValueLen, (const uint8_t *) rendered,
+                         strlen(rendered), pageIdx, pageCount);
+
+    return err;
+}
+
+parser_error_t parser_getCoinItem(const char *name, const parser_span_t *span,
+                                  char *outKey, uint16_t outKeyLen,
+                                  char *outValue, uint16_t outValueLen) {
+    // Coins are decoded from the transaction each time they are shown
+    parser_coin_t coin;
+    CHECK_PARSER_ERR(parser_getCoin(span, &coin))
+
+    const uint8_t *tickerPtr;
+    CHECK_PARSER_ERR(parser_getSpan(&coin.ticker, &tickerPtr))
+
+    char ticker[IOV_TICKER_MAXLEN];
+    CHECK_PARSER_ERR(parser_arrayToString(ticker, IOV_TICKER_MAXLEN,
+                                          tickerPtr, coin.ticker.len,
+                                          0, NULL))
+
+    snprintf(outKey, outKeyLen, "%s [%s]", name, ticker);
+    return parser_formatCoin(outValue, outValueLen, &coin, PARSER_AMOUNT_DISPLAY);
+}
+
+parser_error_t parser_getDisplayItem(int8_t displayIdx, parser_display_item_t *item) {
+    if (displayIdx < 0 || displayIdx >= display_index.count + display_index.multisigCount) {
+        return parser_no_data;
+    }
+
+    if (displayIdx < display_index.count) {
+        *item = display_index.items[displayIdx];
+        return parser_ok;
+    }
+
+    item->field = FIELD_MULTISIG;
+    item->arg = displayIdx - display_index.count;
+    item->valueLen = 0;
+    return parser_ok;
+}
+
+uint8_t parser_getDisplayPageCount(const parser_display_item_t *item, uint16_t outValueLen) {
+    if (!parser_isPaged(item->field)) {
+        return 1;
+    }
+    return parser_pageCount(item->valueLen, outValueLen);
+}
+
+parser_error_t parser_getItemPageCount(int8_t displayIdx,
+                                       uint16_t outValueLen,
+                                       uint8_t *pageCount) {
+    *pageCount = 0;
+    if (outValueLen < 2) {
+        return parser_unexpected_buffer_end;
+    }
+
+    parser_display_item_t item;
+    CHECK_PARSER_ERR(parser_getDisplayItem(displayIdx, &item))
+
+    *pageCount = parser_getDisplayPageCount(&item, outValueLen);
+    return parser_ok;
 }
 
 parser_error_t parser_getItem(parser_context_t *ctx,
@@ -94,94 +427,67 @@ parser_error_t parser_getItem(parser_context_t *ctx,
     snprintf(outKey, outKeyLen, "?");
     snprintf(outValue, outValueLen, "?");
 
-    MEMSET(UI_buffer, 0, UI_BUFFER);
+    parser_display_item_t displayItem;
+    const parser_display_item_t *item = &displayItem;
+    if (parser_getDisplayItem(displayIdx, &displayItem) != parser_ok) {
+        *pageCount = 0;
+        return parser_no_data;
+    }
+
+    *pageCount = parser_getDisplayPageCount(item, outValueLen);
+    if (pageIdx >= *pageCount) {
+        return parser_no_data;
+    }
 
     parser_error_t err = parser_ok;
-    *pageCount = 1;
-    switch (parser_mapDisplayIdx(ctx, displayIdx)) {
+    switch (item->field) {
         case FIELD_CHAINID:     // ChainID
             snprintf(outKey, outKeyLen, "ChainID");
             parser_arrayToString(outValue, outValueLen,
-                                 parser_tx_obj.chainID, parser_tx_obj.chainIDLen,
+                                 parser_getChainID(), parser_tx_obj.chainIDLen,
                                  pageIdx, pageCount);
             break;
         case FIELD_SOURCE:     // Source
             snprintf(outKey, outKeyLen, "Source");
-            err = parser_getAddress(parser_tx_obj.chainID, parser_tx_obj.chainIDLen,
-                                    (char *) UI_buffer, UI_BUFFER,
-                                    parser_tx_obj.sendmsg.sourcePtr,
-                                    parser_tx_obj.sendmsg.sourceLen);
-            // page it
-            parser_arrayToString(outValue, outValueLen, UI_buffer,
-                                 strlen((char *) UI_buffer), pageIdx, pageCount);
+            err = parser_getRenderedItem(RENDER_SLOT_SOURCE,
+                                         outValue, outValueLen,
+                                         pageIdx, pageCount);
             break;
         case FIELD_DESTINATION:     // Destination
             snprintf(outKey, outKeyLen, "Dest");
-            err = parser_getAddress(parser_tx_obj.chainID, parser_tx_obj.chainIDLen,
-                                    (char *) UI_buffer, UI_BUFFER,
-                                    parser_tx_obj.sendmsg.destinationPtr,
-                                    parser_tx_obj.sendmsg.destinationLen);
-            // page it
-            parser_arrayToString(outValue, outValueLen, UI_buffer,
-                                 strlen((char *) UI_buffer), pageIdx, pageCount);
+            err = parser_getRenderedItem(RENDER_SLOT_DESTINATION,
+                                         outValue, outValueLen,
+                                         pageIdx, pageCount);
             break;
-        case FIELD_AMOUNT: {
-            char ticker[IOV_TICKER_MAXLEN];
-            err = parser_arrayToString(ticker, IOV_TICKER_MAXLEN,
-                                       parser_tx_obj.sendmsg.amount.tickerPtr,
-                                       parser_tx_obj.sendmsg.amount.tickerLen,
-                                       0, NULL);
-            if (err != parser_ok)
-                return err;
-
-            snprintf(outKey, outKeyLen, "Amount [%s]", ticker);
-            err = parser_formatAmountFriendly(outValue,
-                                              outValueLen,
-                                              &parser_tx_obj.sendmsg.amount);
+        case FIELD_AMOUNT:
+            err = parser_getCoinItem("Amount", &parser_tx_obj.sendmsg.amount,
+                                     outKey, outKeyLen, outValue, outValueLen);
             break;
-        }
-        case FIELD_FEE: {
-            char ticker[IOV_TICKER_MAXLEN];
-            err = parser_arrayToString(ticker, IOV_TICKER_MAXLEN,
-                                       parser_tx_obj.fees.coin.tickerPtr,
-                                       parser_tx_obj.fees.coin.tickerLen,
-                                       0, NULL);
-            if (err != parser_ok)
-                return err;
-
-            snprintf(outKey, outKeyLen, "Fees [%s]", ticker);
-            err = parser_formatAmountFriendly(outValue,
-                                              outValueLen,
-                                              &parser_tx_obj.fees.coin);
+        case FIELD_FEE:
+            err = parser_getCoinItem("Fees", &parser_tx_obj.fees.coin,
+                                     outKey, outKeyLen, outValue, outValueLen);
             break;
-        }
         case FIELD_MEMO:     // Memo
             snprintf(outKey, outKeyLen, "Memo");
-            err = parser_arrayToString((char *) UI_buffer, UI_BUFFER,
-                                       parser_tx_obj.sendmsg.memoPtr,
-                                       parser_tx_obj.sendmsg.memoLen,
-                                       0, NULL);
-            asciify((char *) UI_buffer);
-            // page it
-            parser_arrayToString(outValue, outValueLen, UI_buffer,
-                                 strlen((char *) UI_buffer),
-                                 pageIdx, pageCount);
+            err = parser_getRenderedItem(RENDER_SLOT_MEMO,
+                                         outValue, outValueLen,
+                                         pageIdx, pageCount);
             break;
-        default:
-            // Handle variable fields
-            if (displayIdx >= parser_getNumItems(ctx)) {
-                *pageCount = 0;
-                return parser_no_data;
-            }
-
-            // Map variable field to multisig
-            uint8_t multisigIdx = displayIdx - FIELD_TOTAL_FIXCOUNT;
+        case FIELD_MULTISIG: {
             snprintf(outKey, outKeyLen, "Multisig");
             if (parser_tx_obj.multisig.count > 1) {
-                snprintf(outKey, outKeyLen, "Multisig [%d/%d]", multisigIdx + 1, parser_tx_obj.multisig.count);
+                snprintf(outKey, outKeyLen, "Multisig [%d/%d]", item->arg + 1, parser_tx_obj.multisig.count);
             }
 
-            uint64_to_str(outValue, outValueLen, parser_tx_obj.multisig.values[multisigIdx]);
+            uint64_t value;
+            err = parser_getMultisig(item->arg, &value);
+            if (err != parser_ok)
+                return err;
+            uint64_to_str(outValue, outValueLen, value);
+            break;
+        }
+        default:
+            return parser_no_data;
     }
 
     return err;
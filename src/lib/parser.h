@@ -28,12 +28,38 @@ const char *parser_getErrorDescription(parser_error_t err);
 parser_error_t parser_parse(parser_context_t *ctx,
                             uint8_t *data, uint16_t dataLen);
 
-//// verifies tx fields
+//// incrementally parses a tx buffer that is still being received
+//// data must hold every byte received so far. Fields that are not complete yet are left for the next call
+parser_error_t parser_parseChunk(parser_context_t *ctx,
+                                 const uint8_t *data, uint16_t dataLen);
+
+//// completes an incremental parse once the whole tx buffer has been received
+parser_error_t parser_parseEnd(parser_context_t *ctx,
+                               const uint8_t *data, uint16_t dataLen);
+
+//// drops rendered display items, must be called whenever the parsed tx changes
+void parser_resetRenderCache();
+
+//// drops the display index and rendered display items
+void parser_resetDisplay();
+
+//// verifies tx fields and builds the display index
 parser_error_t parser_validate(bool_t isMainnet);
 
+//// verifies the header of a tx that is still being received, ok if the header is not complete yet
+parser_error_t parser_validateHeader(const parser_context_t *ctx, bool_t isMainnet);
+
+//// length of a rendered address, 0 if it is too long to be encoded
+uint8_t parser_addressLen(const parser_span_t *address);
+
 //// returns the number of items in the current parsing context
 uint8_t parser_getNumItems(parser_context_t *ctx);
 
+//// number of pages of a field, without rendering it
+parser_error_t parser_getItemPageCount(int8_t displayIdx,
+                                       uint16_t outValueLen,
+                                       uint8_t *pageCount);
+
 // retrieves a readable output for each field / page
 parser_error_t parser_getItem(parser_context_t *ctx,
                               int8_t displayIdx,
@@ -18,15 +18,72 @@
 #include <bech32.h>
 #include "parser_impl.h"
 #include "parser_txdef.h"
+#include "chain.h"
 #include "iov.h"
 
 parser_tx_t parser_tx_obj;
 
+// Segmented data
+// Contexts that start in the head segment continue in the tail segment past the end of the head.
+// Fields are used in place; the only field that can cross the boundary is copied to a scratch area
+segments_t parser_segments;
+// Not in the arena: used when parsing on receive and again when rendering fields on review
+uint8_t parser_straddle[PARSER_STRADDLE_MAX];
+
+void parser_setSegments(const segments_t *segments) {
+    if (segments == NULL || segments->tail == NULL || segments->tailLen == 0) {
+        MEMSET(&parser_segments, 0, sizeof(parser_segments));
+        return;
+    }
+    parser_segments = *segments;
+}
+
+// Bytes that can be read in place from ptr, UINT16_MAX if ptr is not in a segmented head
+uint16_t parser_headAvailable(const uint8_t *ptr) {
+    const uint8_t *head = parser_segments.head;
+    if (parser_segments.tail == NULL || ptr < head || ptr >= head + parser_segments.headLen) {
+        return UINT16_MAX;
+    }
+    return (uint16_t) (head + parser_segments.headLen - ptr);
+}
+
+// Position of a byte, as pointer
+__Z_INLINE const uint8_t *parser_at(const parser_context_t *ctx, uint16_t offset) {
+    if (offset < ctx->headSize) {
+        return ctx->buffer + offset;
+    }
+    return parser_segments.tail + (offset - ctx->headSize);
+}
+
+parser_error_t parser_flattenStraddling(const parser_context_t *ctx, uint16_t offset, uint16_t len,
+                                        const uint8_t **ptr) {
+    const uint16_t inHead = ctx->headSize - offset;
+    if (len > sizeof(parser_straddle)) {
+        return parser_unexpected_field_length;
+    }
+
+    MEMCPY(parser_straddle, ctx->buffer + offset, inHead);
+    MEMCPY(parser_straddle + inHead, parser_segments.tail, len - inHead);
+    *ptr = parser_straddle;
+    return parser_ok;
+}
+
+// Makes a field that crosses the segment boundary readable in place
+__Z_INLINE parser_error_t parser_flatten(const parser_context_t *ctx, uint16_t offset, uint16_t len,
+                                         const uint8_t **ptr) {
+    if (offset >= ctx->headSize || ctx->headSize - offset >= len) {
+        return parser_ok;
+    }
+    return parser_flattenStraddling(ctx, offset, len, ptr);
+}
+
 parser_error_t parser_init_context(parser_context_t *ctx,
                                    const uint8_t *buffer,
                                    uint16_t bufferSize) {
     ctx->offset = 0;
     ctx->lastConsumed = 0;
+    ctx->origin = 0;
+    ctx->partial = bool_false;
 
     if (bufferSize == 0 || buffer == NULL) {
         // Not available, use defaults
@@ -37,16 +94,22 @@ parser_error_t parser_init_context(parser_context_t *ctx,
 
     ctx->buffer = buffer;
     ctx->bufferSize = bufferSize;
+    ctx->headSize = parser_headAvailable(buffer);
 
     return parser_ok;
 }
 
+void parser_setContextSize(parser_context_t *ctx, uint16_t bufferSize) {
+    ctx->bufferSize = bufferSize;
+    ctx->headSize = parser_headAvailable(ctx->buffer);
+}
+
 parser_error_t parser_init(parser_context_t *ctx, const uint8_t *buffer, uint16_t bufferSize) {
     parser_error_t err = parser_init_context(ctx, buffer, bufferSize);
     if (err != parser_ok)
         return err;
 
-    parser_txInit(&parser_tx_obj);
+    parser_txInit(&parser_tx_obj, buffer);
 
     return err;
 }
@@ -79,33 +142,52 @@ const char *parser_getErrorDescription(parser_error_t err) {
 }
 
 parser_error_t _readRawVarint(parser_context_t *ctx, uint64_t *value) {
-    uint16_t offset = ctx->offset + ctx->lastConsumed;
-    uint16_t consumed = 0;
+    const uint16_t offset = ctx->offset + ctx->lastConsumed;
+    if (offset >= ctx->bufferSize) {
+        *value = 0;
+        return parser_unexpected_buffer_end;
+    }
 
-    const uint8_t *p = ctx->buffer + offset;
-    const uint8_t *end = ctx->buffer + ctx->bufferSize + 1;
-    *value = 0;
+    const uint8_t *p = parser_at(ctx, offset);
+    const uint16_t available = ctx->bufferSize - offset;
+    const uint16_t inPlace = offset < ctx->headSize ? ctx->headSize - offset : available;
 
-    // Extract value
-    uint16_t shift = 0;
-    while (p < end && shift < 64) {
-        const uint64_t tmp = ((*p) & 0x7Fu);
+    // Fast path: almost every tag and length in a bnsd transaction takes 1 or 2 bytes
+    if (!(p[0] & 0x80u)) {
+        *value = p[0];
+        ctx->lastConsumed += 1;
+        return parser_ok;
+    }
+
+    if (available >= 2 && inPlace >= 2 && !(p[1] & 0x80u)) {
+        *value = (p[0] & 0x7Fu) | ((uint32_t) p[1] << 7u);
+        ctx->lastConsumed += 2;
+        return parser_ok;
+    }
+
+    // Extract value (up to 10 bytes)
+    const uint16_t maxConsumed = available < 10 ? available : 10;
+    uint64_t tmpValue = 0;
+    for (uint16_t consumed = 0; consumed < maxConsumed; consumed++) {
+        const uint8_t b = consumed < inPlace ? p[consumed] : *parser_at(ctx, offset + consumed);
+        const uint64_t tmp = (b & 0x7Fu);
+        const uint16_t shift = 7 * consumed;
 
         if (shift == 63 && tmp > 1) {
+            *value = 0;
             return parser_value_out_of_range;
         }
 
-        *value += tmp << shift;
+        tmpValue |= tmp << shift;
 
-        consumed++;
-        if (!(*p & 0x80u)) {
-            ctx->lastConsumed += consumed;
+        if (!(b & 0x80u)) {
+            *value = tmpValue;
+            ctx->lastConsumed += consumed + 1;
             return parser_ok;
         }
-        shift += 7;
-        p++;
     }
 
+    *value = 0;
     return parser_unexpected_buffer_end;
 }
 
@@ -199,7 +281,7 @@ parser_error_t _readArray(parser_context_t *ctx, const uint8_t **s, uint16_t *st
         return parser_unexpected_buffer_end;
     }
 
-    *s = ctx->buffer + ctx->offset + ctx->lastConsumed;
+    *s = parser_at(ctx, ctx->offset + ctx->lastConsumed);
     ctx->lastConsumed += *stringLen;
 
     ctx->offset += ctx->lastConsumed;
@@ -207,291 +289,410 @@ parser_error_t _readArray(parser_context_t *ctx, const uint8_t **s, uint16_t *st
     return parser_ok;
 }
 
-parser_error_t _checkValidReadableChars(const uint8_t *p, uint16_t len) {
-    for (uint16_t i = 0; i < len; i++) {
-        uint8_t tmp = *(p + i);
-        if (tmp < 33 || tmp > 127) {
-            return parser_unexpected_characters;
-        }
+parser_error_t _readSpan(parser_context_t *ctx, parser_span_t *span) {
+    const uint8_t *p;
+    uint16_t len;
+    parser_error_t err = _readArray(ctx, &p, &len);
+    if (err != parser_ok) {
+        return err;
     }
+
+    span->offset = ctx->origin + ctx->offset - len;
+    span->len = len;
     return parser_ok;
 }
 
-parser_error_t _checkUppercaseLetters(const uint8_t *p, uint16_t len) {
-    for (uint16_t i = 0; i < len; i++) {
-        uint8_t tmp = *(p + i);
-        if (tmp < 'A' || tmp > 'Z') {
+// Character classes of every byte value, see PARSER_CHARCLASS_*
+const uint8_t parser_charClasses[256] = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x05, 0x05, 0x01,
+        0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+        0x01, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07,
+        0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x01, 0x01, 0x01, 0x01, 0x05,
+        0x01, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05,
+        0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+parser_error_t parser_checkChars(const uint8_t *p, uint16_t len, uint8_t classes) {
+    const uint8_t *table = parser_charClasses;
+    const uint8_t *end = p + len;
+    uint8_t acc = classes;
+
+#if !defined(TARGET_NANOS) && !defined(TARGET_NANOX)
+    // 8 bytes per iteration, the classes they share are accumulated before a single check
+    for (; end - p >= 8; p += 8) {
+        acc &= table[p[0]] & table[p[1]] & table[p[2]] & table[p[3]] &
+               table[p[4]] & table[p[5]] & table[p[6]] & table[p[7]];
+        if (acc != classes) {
             return parser_unexpected_characters;
         }
     }
-    return parser_ok;
-}
+#endif
 
-parser_error_t _checkChainIDValid(const uint8_t *p, uint16_t len) {
-    for (uint16_t i = 0; i < len; i++) {
-        uint8_t tmp = *(p + i);
-
-//        [a-zA-Z0-9_.-]
-        const uint8_t valid = (tmp >= 'a' && tmp <= 'z') ||
-                              (tmp >= 'A' && tmp <= 'Z') ||
-                              (tmp >= '0' && tmp <= '9') ||
-                              tmp == '_' || tmp == '.' || tmp == '-';
-
-        if (!valid) {
-            return parser_unexpected_characters;
-        }
+    for (; p < end; p++) {
+        acc &= table[*p];
+    }
+    if (acc != classes) {
+        return parser_unexpected_characters;
     }
     return parser_ok;
 }
 
-#define DEFINE_CONTEXT() \
-    parser_context_t ctx;   \
-    parser_error_t err = parser_init_context(&ctx, bufferPtr, bufferLen);   \
-    if (err == parser_no_data) { return parser_ok; }        // Not available, use defaults
-
-#define CHECK_NOT_DUPLICATED(FIELD) \
-    if (FIELD) { return parser_duplicated_field; }        \
-    FIELD = 1;
-
-#define READ_NONNEGATIVE_INT64(FIELD) err = _readNonNegativeInt64(&ctx, &FIELD); if (err!=parser_ok) return err;
-#define READ_UINT32(FIELD) err = _readUInt32(&ctx, &FIELD); if (err!=parser_ok) return err;
-#define READ_ARRAY(FIELD) err = _readArray(&ctx, &FIELD##Ptr, &FIELD##Len); if (err!=parser_ok) return err;
+///////////////////////////////////////////////
+// Parsed transaction
+// Fields are kept as spans of the transaction and resolved when they are used
 
-parser_error_t parser_readPB_Metadata(const uint8_t *bufferPtr,
-                                      uint16_t bufferLen,
-                                      parser_metadata_t *metadata) {
-    DEFINE_CONTEXT()
+parser_error_t parser_spanContext(parser_context_t *ctx, const parser_span_t *span) {
+    const uint8_t *ptr = NULL;
+    if (span->len != 0) {
+        // Fields are found in the transaction the same way the transaction context finds them
+        parser_context_t tx;
+        parser_init_context(&tx, parser_tx_obj.buffer, span->offset + span->len);
+        ptr = parser_at(&tx, span->offset);
+    }
 
-    uint64_t v;
-    while (ctx.offset < ctx.bufferSize && err == parser_ok) {
-        err = _readRawVarint(&ctx, &v);
-        if (err != parser_ok) {
-            return err;
-        }
+    parser_error_t err = parser_init_context(ctx, ptr, span->len);
+    ctx->origin = span->offset;
+    return err;
+}
 
-        switch (FIELD_NUM(v)) {
-            case PBIDX_METADATA_SCHEMA: {
-                CHECK_NOT_DUPLICATED(metadata->seen.schema)
-                READ_UINT32(metadata->schema)
-                break;
-            }
-            default:
-                // Unknown fields are rejected to avoid malleability
-                return parser_unexpected_field;
-        }
+parser_error_t parser_getSpan(const parser_span_t *span, const uint8_t **ptr) {
+    *ptr = NULL;
+    if (span->len == 0) {
+        return parser_ok;
     }
 
-    return parser_ok;
+    parser_context_t tx;
+    parser_init_context(&tx, parser_tx_obj.buffer, span->offset + span->len);
+    *ptr = parser_at(&tx, span->offset);
+    return parser_flatten(&tx, span->offset, span->len, ptr);
 }
 
-parser_error_t parser_readPB_Coin(const uint8_t *bufferPtr,
-                                  uint16_t bufferLen,
-                                  parser_coin_t *coin) {
-    DEFINE_CONTEXT()
+const uint8_t *parser_getChainID() {
+    // Shorter than the scratch area, it cannot fail
+    const parser_span_t span = {TX_CHAINID_OFFSET, parser_tx_obj.chainIDLen};
+    const uint8_t *chainID;
+    parser_getSpan(&span, &chainID);
+    return chainID;
+}
 
-    uint64_t v;
-    while (ctx.offset < ctx.bufferSize && err == parser_ok) {
-        err = _readRawVarint(&ctx, &v);
-        if (err != parser_ok) {
-            return err;
-        }
+parser_error_t parser_getMultisig(uint8_t idx, uint64_t *value) {
+    parser_multisig_t *m = &parser_tx_obj.multisig;
+    if (idx >= m->count) {
+        return parser_no_data;
+    }
 
-        switch (FIELD_NUM(v)) {
-            case PBIDX_COIN_WHOLE: {
-                CHECK_NOT_DUPLICATED(coin->seen.whole)
-                READ_NONNEGATIVE_INT64(coin->whole)
-                break;
+    if (idx < m->cursorIdx) {
+        // Walks only go forward
+        m->cursorIdx = 0;
+        m->cursor = m->first;
+    }
+
+    if (idx > m->cursorIdx) {
+        // Other fields of the transaction can be found between two entries
+        const parser_span_t rest = {m->cursor + 8, m->last - m->cursor};
+        parser_context_t ctx;
+        parser_error_t err = parser_spanContext(&ctx, &rest);
+        while (err == parser_ok && m->cursorIdx < idx) {
+            uint64_t tag;
+            parser_span_t field;
+            ctx.lastConsumed = 0;
+            err = _readRawVarint(&ctx, &tag);
+            if (err == parser_ok) {
+                err = _readSpan(&ctx, &field);
             }
-            case PBIDX_COIN_FRACTIONAL: {
-                CHECK_NOT_DUPLICATED(coin->seen.fractional)
-                READ_NONNEGATIVE_INT64(coin->fractional)
-                break;
+            if (err == parser_ok && FIELD_NUM(tag) == PBIDX_TX_MULTISIG) {
+                m->cursorIdx++;
+                m->cursor = field.offset;
             }
-            case PBIDX_COIN_TICKER: {
-                CHECK_NOT_DUPLICATED(coin->seen.ticker)
-                READ_ARRAY(coin->ticker)
-                break;
-            }
-            default:
-                // Unknown fields are rejected to avoid malleability
-                return parser_unexpected_field;
+        }
+        if (err != parser_ok) {
+            return err;
         }
     }
 
-    // Validation
-    if (coin->whole < 0)
-        return parser_value_out_of_range;
-    if (coin->fractional < 0)
-        return parser_value_out_of_range;
-    if (coin->tickerLen < 3 || coin->tickerLen > 4)
-        return parser_value_out_of_range;
-
-    err = _checkUppercaseLetters(coin->tickerPtr, coin->tickerLen);
-    if (err != parser_ok)
+    const parser_span_t span = {m->cursor, 8};
+    const uint8_t *p;
+    parser_error_t err = parser_getSpan(&span, &p);
+    if (err != parser_ok) {
         return err;
+    }
 
+    *value = uint64_from_BEarray(p);
     return parser_ok;
 }
 
-parser_error_t parser_readPB_Fees(const uint8_t *bufferPtr,
-                                  uint16_t bufferLen,
-                                  parser_fees_t *fees) {
-    DEFINE_CONTEXT()
-
-    uint64_t v;
-    while (ctx.offset < ctx.bufferSize && err == parser_ok) {
-        err = _readRawVarint(&ctx, &v);
-        if (err != parser_ok) {
-            return err;
-        }
+#define DEFINE_CONTEXT() \
+    parser_context_t ctx;   \
+    parser_error_t err = parser_spanContext(&ctx, span);   \
+    if (err == parser_no_data) { return parser_ok; }        // Not available, use defaults
 
-        switch (FIELD_NUM(v)) {
-            case PBIDX_FEES_PAYER: {
-                CHECK_NOT_DUPLICATED(fees->seen.payer)
-                READ_ARRAY(fees->payer)
-                break;
-            }
-            case PBIDX_FEES_COIN: {
-                CHECK_NOT_DUPLICATED(fees->seen.coin)
-                READ_ARRAY(fees->coin)
-                break;
-            }
-            default:
-                // Unknown fields are rejected to avoid malleability
-                return parser_unexpected_field;
-        }
+parser_error_t parser_validateCoin(const void *msg) {
+    const parser_coin_t *coin = (const parser_coin_t *) msg;
+    if (coin->ticker.len < 3 || coin->ticker.len > 4) {
+        return parser_value_out_of_range;
     }
 
-    err = parser_readPB_Coin(fees->coinPtr, fees->coinLen, &fees->coin);
-    if (err != parser_ok) return err;
-
-    return parser_ok;
+    const uint8_t *ticker;
+    parser_error_t err = parser_getSpan(&coin->ticker, &ticker);
+    if (err != parser_ok) {
+        return err;
+    }
+    return parser_checkChars(ticker, coin->ticker.len, PARSER_CHARCLASS_UPPERCASE);
 }
 
-parser_error_t parser_readPB_Multisig(parser_context_t *ctx, parser_multisig_t *m) {
-    union {
-        uint64_t v;
-        uint8_t bytes[8];
-    } data;
+parser_error_t parser_readPB_Multisig(parser_context_t *ctx, void *dst) {
+    parser_multisig_t *m = (parser_multisig_t *) dst;
 
     if (m->count >= PBIDX_MULTISIG_COUNT_MAX) {
         return parser_value_out_of_range;
     }
 
-    const uint8_t *p;
-    uint16_t pLen;
-    parser_error_t err = _readArray(ctx, &p, &pLen);
+    // Values are decoded when they are shown
+    parser_span_t span;
+    parser_error_t err = _readSpan(ctx, &span);
     if (err != parser_ok) {
         return err;
     }
 
-    if (pLen != 8) {
+    if (span.len != 8) {
         return parser_unexpected_field_length;
     }
 
-    MEMCPY(data.bytes, p, 8);
-    m->values[m->count] = uint64_from_BEarray(data.bytes);
+    if (m->count == 0) {
+        m->first = span.offset;
+        m->cursor = span.offset;
+    }
+    m->last = span.offset;
     m->count++;
 
     return parser_ok;
 }
 
-parser_error_t parser_readPB_SendMsg(const uint8_t *bufferPtr,
-                                     uint16_t bufferLen,
-                                     parser_sendmsg_t *sendmsg) {
-    DEFINE_CONTEXT()
+///////////////////////////////////////////////
+// Message descriptors
+
+#define PB_UINT32(TYPE, NUM, SEEN, FIELD) \
+    { NUM, PB_FIELD_UINT32, SEEN, offsetof(TYPE, FIELD), NULL, NULL }
+
+#define PB_NONNEGATIVE_INT64(TYPE, NUM, SEEN, FIELD) \
+    { NUM, PB_FIELD_NONNEGATIVE_INT64, SEEN, offsetof(TYPE, FIELD), NULL, NULL }
+
+#define PB_BYTES(TYPE, NUM, SEEN, FIELD) \
+    { NUM, PB_FIELD_BYTES, SEEN, offsetof(TYPE, FIELD), NULL, NULL }
+
+#define PB_MESSAGE(NUM, SEEN, MESSAGE) \
+    { NUM, PB_FIELD_MESSAGE, SEEN, 0, &MESSAGE, NULL }
+
+#define PB_LAZY(TYPE, NUM, SEEN, FIELD, MESSAGE) \
+    { NUM, PB_FIELD_LAZY, SEEN, offsetof(TYPE, FIELD), &MESSAGE, NULL }
+
+#define PB_CUSTOM(TYPE, NUM, FIELD, READER) \
+    { NUM, PB_FIELD_CUSTOM, PB_SEEN_REPEATED, offsetof(TYPE, FIELD), NULL, READER }
+
+#define PB_MESSAGE_DEF(NAME, TYPE, FIELDS, VALIDATE) \
+    const parser_pb_message_t NAME = { FIELDS, sizeof(FIELDS) / sizeof(FIELDS[0]), sizeof(TYPE), offsetof(TYPE, seen), VALIDATE };
+
+// Records of the messages that are only checked while parsing
+typedef union {
+    parser_metadata_t metadata;
+    parser_coin_t coin;
+} parser_pb_scratch_t;
+
+const parser_pb_field_t pb_metadata_fields[] = {
+    PB_UINT32(parser_metadata_t, PBIDX_METADATA_SCHEMA, PBSEEN_METADATA_SCHEMA, schema),
+};
+PB_MESSAGE_DEF(pb_metadata, parser_metadata_t, pb_metadata_fields, NULL)
+
+const parser_pb_field_t pb_coin_fields[] = {
+    PB_NONNEGATIVE_INT64(parser_coin_t, PBIDX_COIN_WHOLE, PBSEEN_COIN_WHOLE, whole),
+    PB_NONNEGATIVE_INT64(parser_coin_t, PBIDX_COIN_FRACTIONAL, PBSEEN_COIN_FRACTIONAL, fractional),
+    PB_BYTES(parser_coin_t, PBIDX_COIN_TICKER, PBSEEN_COIN_TICKER, ticker),
+};
+PB_MESSAGE_DEF(pb_coin, parser_coin_t, pb_coin_fields, parser_validateCoin)
+
+// Fees and SendMsg are stored in the transaction record
+const parser_pb_field_t pb_fees_fields[] = {
+    PB_BYTES(parser_tx_t, PBIDX_FEES_PAYER, PBSEEN_FEES_PAYER, fees.payer),
+    PB_LAZY(parser_tx_t, PBIDX_FEES_COIN, PBSEEN_FEES_COIN, fees.coin, pb_coin),
+};
+PB_MESSAGE_DEF(pb_fees, parser_tx_t, pb_fees_fields, NULL)
+
+const parser_pb_field_t pb_sendmsg_fields[] = {
+    PB_LAZY(parser_tx_t, PBIDX_SENDMSG_METADATA, PBSEEN_SENDMSG_METADATA, sendmsg.metadata, pb_metadata),
+    PB_BYTES(parser_tx_t, PBIDX_SENDMSG_SOURCE, PBSEEN_SENDMSG_SOURCE, sendmsg.source),
+    PB_BYTES(parser_tx_t, PBIDX_SENDMSG_DESTINATION, PBSEEN_SENDMSG_DESTINATION, sendmsg.destination),
+    PB_LAZY(parser_tx_t, PBIDX_SENDMSG_AMOUNT, PBSEEN_SENDMSG_AMOUNT, sendmsg.amount, pb_coin),
+    PB_BYTES(parser_tx_t, PBIDX_SENDMSG_MEMO, PBSEEN_SENDMSG_MEMO, sendmsg.memo),
+    // NOTE: PBIDX_SENDMSG_REF is disabled, it should not appear in any transaction
+};
+PB_MESSAGE_DEF(pb_sendmsg, parser_tx_t, pb_sendmsg_fields, NULL)
+
+const parser_pb_field_t pb_tx_fields[] = {
+    PB_MESSAGE(PBIDX_TX_FEES, PBSEEN_TX_FEES, pb_fees),
+    PB_CUSTOM(parser_tx_t, PBIDX_TX_MULTISIG, multisig, parser_readPB_Multisig),
+    PB_MESSAGE(PBIDX_TX_SENDMSG, PBSEEN_TX_SENDMSG, pb_sendmsg),
+};
+PB_MESSAGE_DEF(pb_tx, parser_tx_t, pb_tx_fields, NULL)
+
+///////////////////////////////////////////////
+// Generic decoder
+
+parser_error_t parser_readPB_Lazy(const parser_pb_field_t *field, const uint8_t *dst) {
+    const parser_pb_message_t *nested = (const parser_pb_message_t *) PIC(field->message);
+    const parser_span_t *span = (const parser_span_t *) (dst + field->offset);
+
+    // Checked now, decoded again from the span when it is used
+    parser_pb_scratch_t scratch;
+    if (nested->size > sizeof(scratch)) {
+        return parser_unexpected_field;
+    }
+    MEMSET(&scratch, 0, nested->size);
+    return parser_readPB_Message(span, nested, &scratch);
+}
 
+parser_error_t parser_readPB_Field(parser_context_t *ctx,
+                                   const parser_pb_message_t *message,
+                                   uint8_t *dst) {
     uint64_t v;
-    while (ctx.offset < ctx.bufferSize && err == parser_ok) {
-        err = _readRawVarint(&ctx, &v);
-        if (err != parser_ok) {
-            return err;
+    parser_error_t err = _readRawVarint(ctx, &v);
+    if (err != parser_ok) {
+        return err;
+    }
+
+    const parser_pb_field_t *fields = (const parser_pb_field_t *) PIC(message->fields);
+    const parser_pb_field_t *field = NULL;
+    for (uint8_t i = 0; i < message->fieldCount; i++) {
+        if (fields[i].fieldNum == FIELD_NUM(v)) {
+            field = fields + i;
+            break;
         }
+    }
 
-        switch (FIELD_NUM(v)) {
-            case PBIDX_SENDMSG_METADATA: {
-                CHECK_NOT_DUPLICATED(sendmsg->seen.metadata)
-                READ_ARRAY(sendmsg->metadata)
-                break;
-            }
-            case PBIDX_SENDMSG_SOURCE: {
-                CHECK_NOT_DUPLICATED(sendmsg->seen.source)
-                READ_ARRAY(sendmsg->source)
-                break;
-            }
-            case PBIDX_SENDMSG_DESTINATION: {
-                CHECK_NOT_DUPLICATED(sendmsg->seen.destination)
-                READ_ARRAY(sendmsg->destination)
-                break;
-            }
-            case PBIDX_SENDMSG_AMOUNT: {
-                CHECK_NOT_DUPLICATED(sendmsg->seen.amount)
-                READ_ARRAY(sendmsg->amount)
-                break;
+    if (field == NULL) {
+        // Unknown fields are rejected to avoid malleability
+        return parser_unexpected_field;
+    }
+
+    if (field->seenBit != PB_SEEN_REPEATED) {
+        uint16_t *seen = (uint16_t *) (dst + message->seenOffset);
+        const uint16_t mask = 1u << field->seenBit;
+        if (*seen & mask) {
+            return parser_duplicated_field;
+        }
+        *seen |= mask;
+    }
+
+    switch (field->type) {
+        case PB_FIELD_UINT32:
+            return _readUInt32(ctx, (uint32_t *) (dst + field->offset));
+        case PB_FIELD_NONNEGATIVE_INT64:
+            return _readNonNegativeInt64(ctx, (int64_t *) (dst + field->offset));
+        case PB_FIELD_BYTES: {
+            parser_span_t *span = (parser_span_t *) (dst + field->offset);
+            err = _readSpan(ctx, span);
+            if (err != parser_ok) {
+                return err;
             }
-            case PBIDX_SENDMSG_MEMO: {
-                CHECK_NOT_DUPLICATED(sendmsg->seen.memo)
-                READ_ARRAY(sendmsg->memo)
-                break;
+            // A field crossing the segment boundary must fit in the scratch area to be used
+            const uint8_t *p;
+            return parser_flatten(ctx, ctx->offset - span->len, span->len, &p);
+        }
+        case PB_FIELD_MESSAGE: {
+            parser_span_t span;
+            err = _readSpan(ctx, &span);
+            if (err != parser_ok) {
+                return err;
             }
-                // NOTE: Disabling this field, it should not appear in any transaction
-//            case PBIDX_SENDMSG_REF: {
-//                CHECK_NOT_DUPLICATED(sendmsg->seen.ref);
-//                READ_ARRAY(sendmsg->ref);
-//                break;
-//            }
-            default:
-                // Unknown fields are rejected to avoid malleability
-                return parser_unexpected_field;
+            const parser_pb_message_t *nested = (const parser_pb_message_t *) PIC(field->message);
+            return parser_readPB_Message(&span, nested, dst);
+        }
+        case PB_FIELD_LAZY:
+            return _readSpan(ctx, (parser_span_t *) (dst + field->offset));
+        case PB_FIELD_CUSTOM: {
+            const parser_pb_reader_t reader = (parser_pb_reader_t) PIC(field->reader);
+            return reader(ctx, dst + field->offset);
         }
+        default:
+            return parser_unexpected_field;
     }
+}
 
-    err = parser_readPB_Metadata(sendmsg->metadataPtr, sendmsg->metadataLen, &sendmsg->metadata);
-    if (err != parser_ok) return err;
+parser_error_t parser_readPB_Message(const parser_span_t *span,
+                                     const parser_pb_message_t *message,
+                                     void *dst) {
+    DEFINE_CONTEXT()
 
-    err = parser_readPB_Coin(sendmsg->amountPtr, sendmsg->amountLen, &sendmsg->amount);
-    return err;
+    while (ctx.offset < ctx.bufferSize) {
+        err = parser_readPB_Field(&ctx, message, (uint8_t *) dst);
+        if (err != parser_ok) {
+            return err;
+        }
+    }
+
+    // Nested messages are checked once the whole message has been read
+    const parser_pb_field_t *fields = (const parser_pb_field_t *) PIC(message->fields);
+    for (uint8_t i = 0; i < message->fieldCount; i++) {
+        if (fields[i].type != PB_FIELD_LAZY) {
+            continue;
+        }
+        err = parser_readPB_Lazy(fields + i, (const uint8_t *) dst);
+        if (err != parser_ok) {
+            return err;
+        }
+    }
+
+    if (message->validate != NULL) {
+        const parser_pb_validator_t validate = (parser_pb_validator_t) PIC(message->validate);
+        return validate(dst);
+    }
+
+    return parser_ok;
+}
+
+parser_error_t parser_getCoin(const parser_span_t *span, parser_coin_t *coin) {
+    parser_coinInit(coin);
+    return parser_readPB_Message(span, &pb_coin, coin);
 }
 
 parser_error_t parser_readPB_Root(parser_context_t *ctx) {
-    parser_error_t err = parser_ok;
-    uint64_t v;
-    while (ctx->offset < ctx->bufferSize && err == parser_ok) {
+    while (ctx->offset < ctx->bufferSize) {
+        const uint16_t fieldOffset = ctx->offset;
+        const uint16_t seen = parser_tx_obj.seen;
 
-        err = _readRawVarint(ctx, &v);
-        if (err != parser_ok) {
-            return err;
+        parser_error_t err = parser_readPB_Field(ctx, &pb_tx, (uint8_t *) &parser_tx_obj);
+        if (err == parser_ok) {
+            continue;
         }
 
-        switch (FIELD_NUM(v)) {
-            case PBIDX_TX_FEES: {
-                CHECK_NOT_DUPLICATED(parser_tx_obj.seen.fees)
-                err = _readArray(ctx, &parser_tx_obj.feesPtr, &parser_tx_obj.feesLen);
-                break;
-            }
-            case PBIDX_TX_MULTISIG: {
-                // This is a repeated field
-                err = parser_readPB_Multisig(ctx, &parser_tx_obj.multisig);
-                if (err != parser_ok)
-                    return err;
-                break;
-            }
-            case PBIDX_TX_SENDMSG: {
-                CHECK_NOT_DUPLICATED(parser_tx_obj.seen.sendmsg)
-                err = _readArray(ctx, &parser_tx_obj.sendmsgPtr, &parser_tx_obj.sendmsgLen);
-                break;
+        if (ctx->partial) {
+            // Roll back so the same field is parsed again when more data arrives
+            ctx->offset = fieldOffset;
+            ctx->lastConsumed = 0;
+            parser_tx_obj.seen = seen;
+
+            if (err == parser_unexpected_buffer_end) {
+                // Field has not been fully received yet
+                return parser_ok;
             }
-            default:
-                // Unknown fields are rejected to avoid malleability
-                return parser_unexpected_field;
         }
+
+        return err;
     }
 
-    return err;
+    return parser_ok;
 }
 
-parser_error_t parser_readRoot(parser_context_t *ctx) {
-    // ---------- READ CUSTOM HEADER (not protobuf)
+parser_error_t parser_readHeader(parser_context_t *ctx) {
     //version | len(chainID) | chainID      | nonce             | signBytes
     //4bytes  | uint8        | ascii string | int64 (bigendian) | serialized transaction
 
@@ -499,190 +700,267 @@ parser_error_t parser_readRoot(parser_context_t *ctx) {
         return parser_unexpected_buffer_end;
     }
 
-    parser_tx_obj.version = (uint32_t *) (ctx->buffer + 0);
-    parser_tx_obj.chainIDLen = *(ctx->buffer + 4);
+    // ---------- VALIDATE HEADER
+    // The version is checked as soon as it has been received, before anything else
+    // Header fields can cross the segment boundary when the transaction is part of a batch
+    const uint8_t *version = parser_at(ctx, 0);
+    parser_error_t err = parser_flatten(ctx, 0, 4, &version);
+    if (err != parser_ok) return err;
 
-    if (parser_tx_obj.chainIDLen < TX_CHAINIDLEN_MIN) {
-        return parser_unexpected_chain;
+    // Byte by byte as transactions in a batch are not word aligned
+    if (version[0] != 0x00 || version[1] != 0xCA || version[2] != 0xFE || version[3] != 0x00) {
+        return parser_unexpected_version;
     }
 
-    if (parser_tx_obj.chainIDLen > TX_CHAINIDLEN_MAX) {
+    if (ctx->bufferSize <= TX_BUFFER_MIN) {
         return parser_unexpected_buffer_end;
     }
 
-    parser_tx_obj.chainID = ctx->buffer + 5;
-    if (_checkChainIDValid(parser_tx_obj.chainID, parser_tx_obj.chainIDLen)) {
-        return parser_unexpected_characters;
+    parser_tx_obj.chainIDLen = *parser_at(ctx, 4);
+
+    if (parser_tx_obj.chainIDLen < TX_CHAINIDLEN_MIN) {
+        return parser_unexpected_chain;
     }
 
-    const uint8_t *p_src = ctx->buffer + 5 + parser_tx_obj.chainIDLen;
-    uint8_t *p_dst = (uint8_t *) &parser_tx_obj.nonce;
-    p_dst[0] = *(p_src + 7);
-    p_dst[1] = *(p_src + 6);
-    p_dst[2] = *(p_src + 5);
-    p_dst[3] = *(p_src + 4);
-    p_dst[4] = *(p_src + 3);
-    p_dst[5] = *(p_src + 2);
-    p_dst[6] = *(p_src + 1);
-    p_dst[7] = *(p_src + 0);
+    if (parser_tx_obj.chainIDLen > TX_CHAINIDLEN_MAX) {
+        return parser_unexpected_buffer_end;
+    }
 
-    ctx->lastConsumed = 5 + parser_tx_obj.chainIDLen + 8;
+    ctx->lastConsumed = TX_CHAINID_OFFSET + parser_tx_obj.chainIDLen + 8;
 
     if (ctx->lastConsumed > ctx->bufferSize) {
         return parser_unexpected_buffer_end;
     }
 
-    // ---------- VALIDATE HEADER
-    // Check version
-    if (*parser_tx_obj.version != 0x00feca00) {
-        return parser_unexpected_version;
-    }
-
-    parser_error_t err = _checkValidReadableChars(parser_tx_obj.chainID, parser_tx_obj.chainIDLen);
+    const uint8_t *chainID = parser_at(ctx, TX_CHAINID_OFFSET);
+    err = parser_flatten(ctx, TX_CHAINID_OFFSET, parser_tx_obj.chainIDLen, &chainID);
     if (err != parser_ok) return err;
 
-    ctx->offset += ctx->lastConsumed;
-    ctx->lastConsumed = 0;
-
-    // ---------- READ SERIALIZED TRANSACTION
-    err = parser_readPB_Root(ctx);
+    // Chain ID characters are readable too, a single sweep covers both
+    err = parser_checkChars(chainID, parser_tx_obj.chainIDLen,
+                            PARSER_CHARCLASS_CHAINID | PARSER_CHARCLASS_READABLE);
     if (err != parser_ok) return err;
 
-    return parser_ok;
-}
+    // Resolved once, addresses and validation only use the registry entry
+    parser_tx_obj.chain = chain_lookup(chainID, parser_tx_obj.chainIDLen);
 
-parser_error_t parser_Tx(parser_context_t *ctx) {
-    parser_error_t err = parser_readRoot(ctx);
-    if (err != parser_ok) return err;
-
-    err = parser_readPB_Fees(parser_tx_obj.feesPtr,
-                             parser_tx_obj.feesLen,
-                             &parser_tx_obj.fees);
-    if (err != parser_ok) return err;
+    // The nonce is not used
 
-    err = parser_readPB_SendMsg(parser_tx_obj.sendmsgPtr,
-                                parser_tx_obj.sendmsgLen,
-                                &parser_tx_obj.sendmsg);
-    if (err != parser_ok) return err;
+    ctx->offset += ctx->lastConsumed;
+    ctx->lastConsumed = 0;
 
     return parser_ok;
 }
 
-bool_t parser_IsMainnet(const uint8_t *chainID, uint16_t chainIDLen) {
-    if (chainIDLen != APP_MAINNET_CHAINID_LEN)
-        return bool_false;
-
-    const char *expectedChainID = APP_MAINNET_CHAINID;
-    for (uint16_t i = 0; i < chainIDLen; i++) {
-        if (chainID[i] != expectedChainID[i]) {
-            return bool_false;
+parser_error_t parser_readRoot(parser_context_t *ctx) {
+    // ---------- READ CUSTOM HEADER (not protobuf)
+    // The header is consumed only once, it is skipped when resuming an incremental parse
+    if (ctx->offset == 0) {
+        parser_error_t err = parser_readHeader(ctx);
+        if (err != parser_ok) {
+            ctx->lastConsumed = 0;
+            if (ctx->partial && err == parser_unexpected_buffer_end) {
+                // Header has not been fully received yet
+                return parser_ok;
+            }
+            return err;
         }
     }
 
-    return bool_true;
+    // ---------- READ SERIALIZED TRANSACTION
+    // Fees and SendMsg are decoded as soon as each of them is available
+    return parser_readPB_Root(ctx);
 }
 
-const char *parser_getHRP(const uint8_t *chainID, uint16_t chainIDLen) {
-    if (parser_IsMainnet(chainID, chainIDLen) == bool_true)
-        return APP_MAINNET_HRP;
+parser_error_t parser_Tx(parser_context_t *ctx) {
+    return parser_readRoot(ctx);
+}
 
-    return APP_TESTNET_HRP;
+const char *parser_getHRP() {
+    return chain_get(parser_tx_obj.chain)->hrp;
 }
 
-parser_error_t parser_getAddress(const uint8_t *chainID, uint16_t chainIDLen,
+parser_error_t parser_getAddress(const char *hrp,
                                  char *addr, uint16_t addrLen,
                                  const uint8_t *ptr, uint16_t len) {
     if (addrLen < IOV_ADDR_MAXLEN) {
         return parser_unexpected_buffer_end;
     }
 
-    const char *hrp = parser_getHRP(chainID, chainIDLen);
-    bech32EncodeFromBytes(addr, hrp, ptr, len);
+    if (len == BECH32_PAYLOAD20_LEN) {
+        bech32EncodeFromBytes20(addr, hrp, ptr);
+    } else {
+        bech32EncodeFromBytes(addr, hrp, ptr, len);
+    }
 
     return parser_ok;
 }
 
+uint8_t parser_pageCount(uint16_t len, uint16_t outLen) {
+    // As many characters as fit before the terminator go in each page
+    // Lengths that are an exact multiple of the page get an empty last page
+    return 1 + len / (outLen - 1);
+}
+
 parser_error_t parser_arrayToString(char *out, uint16_t outLen,
                                     const uint8_t *in, uint8_t inLen,
                                     uint8_t pageIdx, uint8_t *pageCount) {
     // This function assumes that in is not zero-terminated
     // but outlen needs to be zero-terminated so it will reserve the last byte for termination
-
-    if (pageCount == NULL && inLen > outLen - 1) {
-        // It does not fit and paging is disabled
+    if (outLen == 0) {
         return parser_unexpected_buffer_end;
     }
-
-    MEMSET((void *) out, 0, outLen);      // Ensure it will be zero terminated
+    const uint16_t pageLen = outLen - 1;
 
     if (pageCount != NULL) {
-        *pageCount = 1 + inLen / (outLen - 1);
+        if (pageLen == 0) {
+            return parser_unexpected_buffer_end;
+        }
+        *pageCount = parser_pageCount(inLen, outLen);
+    } else if (inLen > pageLen) {
+        // It does not fit and paging is disabled
+        return parser_unexpected_buffer_end;
     } else {
         pageIdx = 0;
     }
 
-    const int16_t offset = (outLen - 1) * pageIdx;
-
-    // Limit chunk size
-    int16_t chunkSize = outLen - 1;
-    if (chunkSize > inLen - offset) {
+    // Only the characters of the page and the terminator are written, the rest of out is left as is
+    const uint32_t offset = (uint32_t) pageLen * pageIdx;
+    uint16_t chunkSize = 0;
+    if (offset < inLen) {
         chunkSize = inLen - offset;
+        if (chunkSize > pageLen) {
+            chunkSize = pageLen;
+        }
     }
 
     MEMCPY(out, in + offset, chunkSize);
+    out[chunkSize] = 0;
 
     return parser_ok;
 }
 
-parser_error_t parser_formatAmount(char *out, uint16_t outLen, parser_coin_t *coin) {
+// Amounts
+// Digits are written right to left straight into the output, two at a time
+static const char parser_digitPairs[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+__Z_INLINE char *parser_putPair(char *p, uint8_t value) {
+    const char *pair = parser_digitPairs + 2 * value;
+    *(--p) = pair[1];
+    *(--p) = pair[0];
+    return p;
+}
+
+__Z_INLINE uint8_t parser_countDigits(uint64_t value) {
+    uint8_t digits = 1;
+    uint64_t limit = 10;
+    // int64 values have at most 19 digits, limit does not overflow
+    while (digits < 19 && value >= limit) {
+        digits++;
+        limit *= 10;
+    }
+    return digits;
+}
+
+parser_error_t parser_formatCoin(char *out, uint16_t outLen, const parser_coin_t *coin, uint8_t flags) {
     if (outLen < IOV_WHOLE_DIGITS + IOV_FRAC_DIGITS + 2) {
         return parser_unexpected_buffer_end;
     }
-    MEMSET(out, 0, outLen);
-
-    if (coin->whole > 0) {
-        if (int64_to_str(out, outLen, coin->whole)) return parser_unexpected_buffer_end;
-        uint8_t out_p = strlen(out);
-        MEMSET(out + out_p, '0', IOV_FRAC_DIGITS);        // Fill with 9 zeros
+    // The parser only accepts non negative values
+    if (coin->whole < 0 || coin->fractional < 0) {
+        return parser_value_out_of_range;
+    }
 
-        if (coin->fractional > 0) {
-            // concatenate and fill with zeros
-            char f[IOV_FRAC_DIGITS + 1];
-            MEMSET(f, 0, IOV_FRAC_DIGITS + 1);
-            if (int64_to_str(f, IOV_FRAC_DIGITS + 1, coin->fractional)) return parser_unexpected_buffer_end;
+    uint64_t whole = coin->whole;
+    uint64_t fractional = coin->fractional;
+    uint8_t fracDigits = IOV_FRAC_DIGITS;
+    if (parser_countDigits(fractional) > IOV_FRAC_DIGITS) {
+        return parser_unexpected_buffer_end;
+    }
 
-            uint8_t fLen = strlen(f);
-            MEMCPY(out + out_p + (IOV_FRAC_DIGITS - fLen), f, fLen);
+    const bool_t friendly = (flags & PARSER_AMOUNT_FRIENDLY) != 0;
+    if (!friendly) {
+        // Trimming or grouping would change the meaning of a plain amount
+        flags = 0;
+        if (whole == 0) {
+            // Only the fractional part, without padding
+            whole = fractional;
+            fracDigits = 0;
+        }
+    } else if (flags & PARSER_AMOUNT_TRIM) {
+        while (fracDigits > 0 && fractional % 10 == 0) {
+            fractional /= 10;
+            fracDigits--;
         }
-
-    } else {
-        if (int64_to_str(out, outLen, coin->fractional)) return parser_unexpected_buffer_end;
     }
 
-    return parser_ok;
-}
-
-parser_error_t parser_formatAmountFriendly(char *out, uint16_t outLen, parser_coin_t *coin) {
-    if (outLen < IOV_WHOLE_DIGITS + IOV_FRAC_DIGITS + 2) {
+    const uint8_t wholeDigits = parser_countDigits(whole);
+    uint16_t len = wholeDigits + fracDigits;
+    if (flags & PARSER_AMOUNT_GROUP) {
+        len += (wholeDigits - 1) / 3;
+    }
+    if (friendly && fracDigits > 0) {
+        len++;
+    }
+    if (len >= outLen) {
         return parser_unexpected_buffer_end;
     }
-    MEMSET(out, 0, outLen);
 
-    if (int64_to_str(out, outLen, coin->whole)) return parser_unexpected_buffer_end;
-    uint8_t out_p = strlen(out);
-    *(out + out_p) = '.';
-    out_p++;
-    MEMSET(out + out_p, '0', IOV_FRAC_DIGITS);        // Fill with 9 zeros
+    char *p = out + len;
+    *p = 0;
 
-    if (coin->fractional > 0) {
-        // concatenate and fill with zeros
-        char f[IOV_FRAC_DIGITS + 1];
-        MEMSET(f, 0, IOV_FRAC_DIGITS + 1);
-        if (int64_to_str(f, IOV_FRAC_DIGITS + 1, coin->fractional)) return parser_unexpected_buffer_end;
+    // Fractional part, zero padded to fracDigits
+    if (fracDigits > 0) {
+        uint8_t remaining = fracDigits;
+        for (; remaining >= 2; remaining -= 2) {
+            p = parser_putPair(p, fractional % 100);
+            fractional /= 100;
+        }
+        if (remaining > 0) {
+            *(--p) = (char) ('0' + fractional);
+        }
+        if (friendly) {
+            *(--p) = '.';
+        }
+    }
 
-        uint8_t fLen = strlen(f);
-        MEMCPY(out + out_p + (IOV_FRAC_DIGITS - fLen), f, fLen);
+    // Whole part
+    if (flags & PARSER_AMOUNT_GROUP) {
+        while (whole >= 1000) {
+            const uint16_t group = whole % 1000;
+            whole /= 1000;
+            p = parser_putPair(p, group % 100);
+            *(--p) = (char) ('0' + group / 100);
+            *(--p) = PARSER_AMOUNT_GROUP_SEPARATOR;
+        }
+    }
+    while (whole >= 100) {
+        p = parser_putPair(p, whole % 100);
+        whole /= 100;
+    }
+    if (whole >= 10) {
+        parser_putPair(p, whole);
+    } else {
+        *(--p) = (char) ('0' + whole);
     }
 
     return parser_ok;
 }
+
+parser_error_t parser_formatAmount(char *out, uint16_t outLen, parser_coin_t *coin) {
+    return parser_formatCoin(out, outLen, coin, 0);
+}
+
+parser_error_t parser_formatAmountFriendly(char *out, uint16_t outLen, parser_coin_t *coin) {
+    return parser_formatCoin(out, outLen, coin, PARSER_AMOUNT_FRIENDLY);
+}
@@ -42,6 +42,12 @@ typedef struct {
     uint16_t bufferSize;
     uint16_t offset;
     uint16_t lastConsumed;
+    // Bytes that can be read in place from buffer, the rest continues in the tail segment
+    uint16_t headSize;
+    // Position of buffer in the transaction, fields are stored relative to the transaction
+    uint16_t origin;
+    // More data is still being received (incremental parsing)
+    bool_t partial;
 } parser_context_t;
 
 extern parser_tx_t parser_tx_obj;
@@ -54,6 +60,58 @@ extern parser_tx_t parser_tx_obj;
 #define FIELD_NUM(x) ((x) >> 3u)
 #define WIRE_TYPE(x) ((uint8_t)((x) & 0x7u))
 
+// Protobuf message descriptors
+// Each message is decoded by a single generic loop driven by a constant table of fields
+
+#define PB_SEEN_REPEATED   0xFF            // Field can appear more than once
+
+typedef enum {
+    PB_FIELD_UINT32 = 0,                    // varint -> uint32_t
+    PB_FIELD_NONNEGATIVE_INT64 = 1,         // varint -> int64_t, negative values are rejected
+    PB_FIELD_BYTES = 2,                     // length delimited -> span
+    PB_FIELD_MESSAGE = 3,                   // length delimited -> nested fields, stored in the same record
+    PB_FIELD_LAZY = 4,                      // length delimited -> span, the nested message is only checked
+    PB_FIELD_CUSTOM = 5,                    // decoded by a dedicated reader (e.g. repeated fields)
+} parser_pb_field_type_t;
+
+typedef parser_error_t (*parser_pb_reader_t)(parser_context_t *ctx, void *dst);
+
+typedef parser_error_t (*parser_pb_validator_t)(const void *msg);
+
+typedef struct parser_pb_message_t parser_pb_message_t;
+
+typedef struct {
+    uint8_t fieldNum;
+    uint8_t type;                           // parser_pb_field_type_t
+    uint8_t seenBit;                        // duplicate check bit or PB_SEEN_REPEATED
+    uint16_t offset;                        // destination value / span
+    const parser_pb_message_t *message;     // nested message descriptor
+    parser_pb_reader_t reader;              // custom reader
+} parser_pb_field_t;
+
+struct parser_pb_message_t {
+    const parser_pb_field_t *fields;
+    uint8_t fieldCount;
+    uint16_t size;                          // of the record, for messages that are decoded on their own
+    uint16_t seenOffset;
+    parser_pb_validator_t validate;         // optional, called once all fields have been read
+};
+
+// Largest field that can cross the boundary between two segments
+#define PARSER_STRADDLE_MAX TX_MEMOLEN_MAX
+
+/// Data passed to the parser may continue in a second segment
+/// Contexts starting in the head continue in the tail past the end of the head
+/// \param segments NULL or an empty tail for contiguous data
+void parser_setSegments(const segments_t *segments);
+
+parser_error_t parser_init_context(parser_context_t *ctx,
+                                   const uint8_t *buffer,
+                                   uint16_t bufferSize);
+
+/// Updates the amount of data in a context, e.g. when more data has been received
+void parser_setContextSize(parser_context_t *ctx, uint16_t bufferSize);
+
 parser_error_t parser_init(parser_context_t *ctx,
                            const uint8_t *buffer,
                            uint16_t bufferSize);
@@ -66,40 +124,105 @@ parser_error_t _readUInt32(parser_context_t *ctx, uint32_t *value);
 
 parser_error_t _readArray(parser_context_t *ctx, const uint8_t **s, uint16_t *stringLen);
 
-parser_error_t parser_readPB_Metadata(const uint8_t *bufferPtr,
-                                      uint16_t bufferLen,
-                                      parser_metadata_t *metadata);
-
-parser_error_t parser_readPB_Coin(const uint8_t *bufferPtr,
-                                  uint16_t bufferLen,
-                                  parser_coin_t *coin);
-
-parser_error_t parser_readPB_Fees(const uint8_t *bufferPtr,
-                                  uint16_t bufferLen,
-                                  parser_fees_t *fees);
-
-parser_error_t parser_readPB_SendMsg(const uint8_t *bufferPtr,
-                                     uint16_t bufferLen,
-                                     parser_sendmsg_t *sendmsg);
+parser_error_t _readSpan(parser_context_t *ctx, parser_span_t *span);
+
+/// Context over a field of the transaction
+/// \param ctx
+/// \param span
+/// \return parser_no_data if the field is empty
+parser_error_t parser_spanContext(parser_context_t *ctx, const parser_span_t *span);
+
+/// Make a field of the parsed transaction readable in place
+/// A field that crosses the segment boundary is copied to a scratch area, valid until the next call
+/// \param span
+/// \param ptr NULL for empty fields
+/// \return
+parser_error_t parser_getSpan(const parser_span_t *span, const uint8_t **ptr);
+
+/// Chain ID of the parsed transaction
+/// \return
+const uint8_t *parser_getChainID();
+
+/// Decode a coin of the parsed transaction
+/// \param span e.g. parser_tx_obj.sendmsg.amount
+/// \param coin zero when the field is absent
+/// \return
+parser_error_t parser_getCoin(const parser_span_t *span, parser_coin_t *coin);
+
+/// Decode a multisig entry of the parsed transaction
+/// Entries are found by walking the transaction from the last one returned, in order they cost O(1) each
+/// \param idx below parser_tx_obj.multisig.count
+/// \param value
+/// \return
+parser_error_t parser_getMultisig(uint8_t idx, uint64_t *value);
+
+parser_error_t parser_readPB_Field(parser_context_t *ctx,
+                                   const parser_pb_message_t *message,
+                                   uint8_t *dst);
+
+parser_error_t parser_readPB_Message(const parser_span_t *span,
+                                     const parser_pb_message_t *message,
+                                     void *dst);
 
 parser_error_t parser_readPB_Root(parser_context_t *ctx);
 
+parser_error_t parser_readHeader(parser_context_t *ctx);
+
 parser_error_t parser_readRoot(parser_context_t *ctx);
 
 parser_error_t parser_Tx(parser_context_t *ctx);
 
-bool_t parser_IsMainnet(const uint8_t *chainID, uint16_t chainIDLen);
-
-const char *parser_getHRP(const uint8_t *chainID, uint16_t chainIDLen);
+/// HRP of the addresses of the parsed transaction
+/// \return
+const char *parser_getHRP();
 
-parser_error_t parser_getAddress(const uint8_t *chainID, uint16_t chainIDLen,
+parser_error_t parser_getAddress(const char *hrp,
                                  char *addr, uint16_t addrLen,
                                  const uint8_t *ptr, uint16_t len);
 
+// Character classes
+#define PARSER_CHARCLASS_READABLE   0x01u   // printable ASCII without space, [33, 127]
+#define PARSER_CHARCLASS_UPPERCASE  0x02u   // [A-Z]
+#define PARSER_CHARCLASS_CHAINID    0x04u   // [a-zA-Z0-9_.-]
+
+/// Check that every byte belongs to all the character classes given
+/// \param p
+/// \param len
+/// \param classes PARSER_CHARCLASS_*
+/// \return parser_unexpected_characters if any byte does not
+parser_error_t parser_checkChars(const uint8_t *p, uint16_t len, uint8_t classes);
+
+/// Number of pages parser_arrayToString needs for len characters, nothing is copied
+/// \param len
+/// \param outLen output size, including the terminator
+/// \return
+uint8_t parser_pageCount(uint16_t len, uint16_t outLen);
+
 parser_error_t parser_arrayToString(char *out, uint16_t outLen,
                                     const uint8_t *in, uint8_t inLen,
                                     uint8_t pageIdx, uint8_t *pageCount);
 
+// Amount formatting flags
+#define PARSER_AMOUNT_FRIENDLY  0x01u   // whole.fractional, otherwise a plain number of 10^-9 units
+#define PARSER_AMOUNT_TRIM      0x02u   // drop trailing zeros of the fractional part (friendly only)
+#define PARSER_AMOUNT_GROUP     0x04u   // separate thousands of the whole part (friendly only)
+
+#define PARSER_AMOUNT_GROUP_SEPARATOR   ','
+
+// Format used for the amounts shown for review
+// e.g. PARSER_AMOUNT_FRIENDLY | PARSER_AMOUNT_TRIM shortens 1.500000000 to 1.5
+#ifndef PARSER_AMOUNT_DISPLAY
+#define PARSER_AMOUNT_DISPLAY   PARSER_AMOUNT_FRIENDLY
+#endif
+
+/// Format a coin in a single pass
+/// \param out
+/// \param outLen at least IOV_WHOLE_DIGITS + IOV_FRAC_DIGITS + 2
+/// \param coin
+/// \param flags PARSER_AMOUNT_*
+/// \return parser_unexpected_buffer_end if the result does not fit
+parser_error_t parser_formatCoin(char *out, uint16_t outLen, const parser_coin_t *coin, uint8_t flags);
+
 parser_error_t parser_formatAmount(char *out, uint16_t outLen, parser_coin_t *coin);
 parser_error_t parser_formatAmountFriendly(char *out, uint16_t outLen, parser_coin_t *coin);
 
@@ -47,11 +47,21 @@ extern "C" {
 #define TX_MEMOLEN_MAX      128
 #define PBIDX_METADATA_SCHEMA      1
 
+#define PBSEEN_METADATA_SCHEMA     0
+
+// Position of a field in the transaction
+// Offsets are relative to the start of the transaction, see parser_getSpan
+typedef struct {
+    uint16_t offset;
+    uint16_t len;
+} parser_span_t;
+
+// Messages that are checked while parsing and decoded again when they are used (see parser_getCoin)
+// They are not part of the parsed transaction, so their fields keep their own duplicate check bits
+
 typedef struct {
     // These bits are to avoid duplicated fields
-    struct {
-        unsigned int schema : 1;
-    } seen;
+    uint16_t seen;
 
     uint32_t schema;
 } parser_metadata_t;
@@ -60,119 +70,94 @@ typedef struct {
 #define PBIDX_COIN_FRACTIONAL      2
 #define PBIDX_COIN_TICKER          3
 
+#define PBSEEN_COIN_WHOLE          0
+#define PBSEEN_COIN_FRACTIONAL     1
+#define PBSEEN_COIN_TICKER         2
+
 typedef struct {
     // These bits are to avoid duplicated fields
-    struct {
-        unsigned int whole : 1;
-        unsigned int fractional : 1;
-        unsigned int ticker : 1;
-    } seen;
+    uint16_t seen;
 
     int64_t whole;
     int64_t fractional;
-    const uint8_t *tickerPtr;
-    uint16_t tickerLen;
+    parser_span_t ticker;
 } parser_coin_t;
 
+// Parsed transaction
+// Fields of the transaction and of the messages it contains share a single presence mask
+
+#define PBIDX_TX_FEES           1
+#define PBIDX_TX_MULTISIG       4
+#define PBIDX_TX_SENDMSG        51
+
 #define PBIDX_FEES_PAYER           2
 #define PBIDX_FEES_COIN            3
 
-typedef struct {
-    // These bits are to avoid duplicated fields
-    struct {
-        unsigned int payer : 1;
-        unsigned int coin : 1;
-    } seen;
+#define PBIDX_SENDMSG_METADATA          1
+#define PBIDX_SENDMSG_SOURCE            2
+#define PBIDX_SENDMSG_DESTINATION       3
+#define PBIDX_SENDMSG_AMOUNT            4
+#define PBIDX_SENDMSG_MEMO              5
+#define PBIDX_SENDMSG_REF               6
 
-    const uint8_t *payerPtr;
-    uint16_t payerLen;
+#define PBSEEN_TX_FEES                  0
+#define PBSEEN_TX_SENDMSG               1
+#define PBSEEN_FEES_PAYER               2
+#define PBSEEN_FEES_COIN                3
+#define PBSEEN_SENDMSG_METADATA         4
+#define PBSEEN_SENDMSG_SOURCE           5
+#define PBSEEN_SENDMSG_DESTINATION      6
+#define PBSEEN_SENDMSG_AMOUNT           7
+#define PBSEEN_SENDMSG_MEMO             8
+#define PBSEEN_SENDMSG_REF              9
 
-    const uint8_t *coinPtr;
-    uint16_t coinLen;
-    parser_coin_t coin;
+typedef struct {
+    parser_span_t payer;
+    parser_span_t coin;                 // parser_coin_t
 } parser_fees_t;
 
-#define PBIDX_MULTISIG_COUNT_MAX        8
+// Display indexes are signed 8 bit values, multisig entries share them with the other items
+#define PBIDX_MULTISIG_COUNT_MAX        120
 
+// Multisig entries are 8 byte big endian values, the repeated field is walked when they are shown
+// RAM use does not depend on the number of entries, see parser_getMultisig
 typedef struct {
-    // These bits are to avoid duplicated fields
     uint8_t count;
-    uint64_t values[PBIDX_MULTISIG_COUNT_MAX];
+    uint8_t cursorIdx;                  // entry found by the last walk
+    uint16_t cursor;
+    uint16_t first;
+    uint16_t last;
 } parser_multisig_t;
 
-#define PBIDX_SENDMSG_METADATA          1
-#define PBIDX_SENDMSG_SOURCE            2
-#define PBIDX_SENDMSG_DESTINATION       3
-#define PBIDX_SENDMSG_AMOUNT            4
-#define PBIDX_SENDMSG_MEMO              5
-#define PBIDX_SENDMSG_REF               6
-
 typedef struct {
-    // These bits are to avoid duplicated fields
-    struct {
-        unsigned int metadata : 1;
-        unsigned int source : 1;
-        unsigned int destination : 1;
-        unsigned int amount : 1;
-        unsigned int memo : 1;
-        unsigned int ref : 1;
-    } seen;
-
-    const uint8_t *metadataPtr;
-    uint16_t metadataLen;
-    parser_metadata_t metadata;
-
-    const uint8_t *sourcePtr;
-    uint16_t sourceLen;
-
-    const uint8_t *destinationPtr;
-    uint16_t destinationLen;
-
-    const uint8_t *amountPtr;
-    uint16_t amountLen;
-    parser_coin_t amount;
-
-    const uint8_t *memoPtr;
-    uint16_t memoLen;
-
-    const uint8_t *refPtr;
-    uint16_t refLen;
+    parser_span_t metadata;             // parser_metadata_t, checked but not shown
+    parser_span_t source;
+    parser_span_t destination;
+    parser_span_t amount;               // parser_coin_t
+    parser_span_t memo;
+    // NOTE: PBIDX_SENDMSG_REF is disabled, it should not appear in any transaction
 } parser_sendmsg_t;
 
-#define PBIDX_TX_FEES           1
-#define PBIDX_TX_MULTISIG       4
-#define PBIDX_TX_SENDMSG        51
+// Version, chain ID and nonce are at fixed positions of the header, only the chain ID length is kept
+#define TX_CHAINID_OFFSET       5
 
 typedef struct {
-    const uint32_t *version;
+    const uint8_t *buffer;              // start of the transaction, spans are relative to it
+
+    // These bits are to avoid duplicated fields, see PBSEEN_*
+    uint16_t seen;
+
     uint8_t chainIDLen;
-    const uint8_t *chainID;
-    int64_t nonce;
-
-    ////
-    struct {
-        unsigned int fees : 1;
-        unsigned int sendmsg : 1;
-    } seen;
-
-    const uint8_t *feesPtr;
-    uint16_t feesLen;
-    parser_fees_t fees;             // PB Field 1
-
-    const uint8_t *multisigPtr;
-    uint16_t multisigLen;
-    parser_multisig_t multisig;        // PB Field 4
-
-    const uint8_t *sendmsgPtr;
-    uint16_t sendmsgLen;
-    parser_sendmsg_t sendmsg;       // PB Field 51
+    uint8_t chain;                      // registry entry of the chain ID, see chain.h
+
+    parser_fees_t fees;                 // PB Field 1
+    parser_multisig_t multisig;         // PB Field 4
+    parser_sendmsg_t sendmsg;           // PB Field 51
 } parser_tx_t;
 
+void parser_metadataInit(parser_metadata_t *metadata);
 void parser_coinInit(parser_coin_t *coin);
-void parser_feesInit(parser_fees_t *fees);
-void parser_multisigInit(parser_multisig_t *msg);
-void parser_sendmsgInit(parser_sendmsg_t *msg);
-void parser_txInit(parser_tx_t *tx);
+void parser_txInit(parser_tx_t *tx, const uint8_t *buffer);
 
 #ifdef __cplusplus
 }
@@ -16,15 +16,19 @@
 
 #include "tx.h"
 #include "apdu_codes.h"
-#include "buffering.h"
+#include "segbuffer.h"
 #include "lib/parser.h"
+#include "lib/crypto.h"
+#include "lib/arena.h"
+#include <zxmacros.h>
 #include <string.h>
 
 #if defined(TARGET_NANOX)
 #define RAM_BUFFER_SIZE 8192
 #define FLASH_BUFFER_SIZE 16384
 #elif defined(TARGET_NANOS)
-#define RAM_BUFFER_SIZE 416
+// RAM saved by overlaying phase exclusive buffers keeps typical transactions out of flash
+#define RAM_BUFFER_SIZE (416 + ARENA_RECLAIMED)
 #define FLASH_BUFFER_SIZE 8192
 #endif
 
@@ -37,18 +41,51 @@ typedef struct {
 } storage_t;
 
 #if defined(TARGET_NANOS)
-storage_t N_appdata_impl __attribute__ ((aligned(64)));
+storage_t N_appdata_impl NV_ALIGN;
 #define N_appdata (*(storage_t *)PIC(&N_appdata_impl))
 
 #elif defined(TARGET_NANOX)
-storage_t const N_appdata_impl __attribute__ ((aligned(64)));
+storage_t const N_appdata_impl NV_ALIGN;
 #define N_appdata (*(volatile storage_t *)PIC(&N_appdata_impl))
 #endif
 
+// nvpage stages whole pages, the flash buffer must not share one with other data
+_Static_assert(__alignof__(N_appdata_impl) % NVPAGE_SIZE == 0, "N_appdata must be page aligned");
+_Static_assert(sizeof(N_appdata_impl.buffer) % NVPAGE_SIZE == 0, "N_appdata must fill whole pages");
+
 parser_context_t ctx_parsed_tx;
+// Result of parsing the chunks received so far
+parser_error_t ctx_partial_err;
+
+// Batch
+typedef struct {
+    bool_t active;
+    bool_t isMainnet;
+    uint8_t count;
+    uint8_t current;                        // transaction currently loaded in the parser
+    uint16_t offset[TX_BATCH_MAX];
+    uint16_t length[TX_BATCH_MAX];
+    uint8_t numItems[TX_BATCH_MAX];
+} tx_batch_t;
+
+tx_batch_t tx_batch;
+
+// Digest of the transaction buffer, updated as chunks arrive
+typedef enum {
+    tx_digest_none = 0,                     // not computed, e.g. batch mode or data added after completion
+    tx_digest_updating = 1,
+    tx_digest_done = 2,
+} tx_digest_state_t;
+
+tx_digest_state_t tx_digest_state;
+// Not in the arena: final when the tx is parsed and read when signing, so it is live
+// together with the review buffers that already fill the arena
+uint8_t tx_digest[CRYPTO_DIGEST_LEN];
+
+#define TX_BATCH_SUMMARY_ITEMS 1
 
 void tx_initialize() {
-    buffering_init(
+    segbuffer_init(
         ram_buffer,
         sizeof(ram_buffer),
         N_appdata.buffer,
@@ -57,25 +94,134 @@ void tx_initialize() {
 }
 
 void tx_reset() {
-    buffering_reset();
+    segbuffer_reset();
+    // Drop any partially parsed transaction
+    parser_init(&ctx_parsed_tx, NULL, 0);
+    ctx_partial_err = parser_ok;
+    parser_resetDisplay();
+    MEMSET(&tx_batch, 0, sizeof(tx_batch));
+    arena_enter(arena_phase_receive);
+    crypto_digestInit();
+    tx_digest_state = tx_digest_updating;
 }
 
-uint32_t tx_append(unsigned char *buffer, uint32_t length) {
-    return buffering_append(buffer, length);
+void tx_batch_begin() {
+    tx_batch.active = bool_true;
+    // Every transaction in the batch is hashed separately when signing
+    tx_digest_state = tx_digest_none;
 }
 
 uint32_t tx_get_buffer_length() {
-    return buffering_get_buffer()->pos;
+    return segbuffer_get_length();
+}
+
+void tx_get_slice(uint16_t offset, uint16_t length, segments_t *slice) {
+    const buffer_state_t *ram = segbuffer_get_ram_buffer();
+    const buffer_state_t *flash = segbuffer_get_flash_buffer();
+
+    MEMSET(slice, 0, sizeof(segments_t));
+    if (offset >= ram->pos) {
+        slice->head = flash->data + (offset - ram->pos);
+        slice->headLen = length;
+        return;
+    }
+
+    slice->head = ram->data + offset;
+    slice->headLen = length;
+    if (offset + length > ram->pos) {
+        slice->headLen = ram->pos - offset;
+        slice->tail = flash->data;
+        slice->tailLen = length - slice->headLen;
+    }
+}
+
+void tx_get_message(segments_t *message) {
+    tx_get_slice(0, tx_get_buffer_length(), message);
+}
+
+void tx_set_parser_segments() {
+    // The RAM segment is full before anything goes to flash, parser contexts starting in RAM continue in flash
+    segments_t segments;
+    tx_get_message(&segments);
+    parser_setSegments(&segments);
+}
+
+uint8_t tx_get_byte(uint16_t offset) {
+    const buffer_state_t *ram = segbuffer_get_ram_buffer();
+    if (offset < ram->pos) {
+        return ram->data[offset];
+    }
+    return segbuffer_get_flash_buffer()->data[offset - ram->pos];
+}
+
+uint8_t *tx_get_scratch(uint16_t *length) {
+    const buffer_state_t *ram = segbuffer_get_ram_buffer();
+    *length = ram->size - ram->pos;
+    return ram->data + ram->pos;
+}
+
+const uint8_t *tx_get_digest() {
+    return tx_digest_state == tx_digest_done ? tx_digest : NULL;
+}
+
+uint32_t tx_append(unsigned char *buffer, uint32_t length) {
+    const uint32_t appended = segbuffer_append(buffer, length);
+
+    if (appended == length) {
+        // Hashing while chunks arrive leaves only the signature to do once the user approves
+        // Anything shown in between (e.g. an address) reuses the memory of the digest, it is then dropped
+        if (tx_digest_state == tx_digest_updating && arena_get_phase() == arena_phase_receive) {
+            crypto_digestUpdate(buffer, length);
+        } else {
+            tx_digest_state = tx_digest_none;
+        }
+    }
+
+    if (tx_batch.active) {
+        // Transactions are split once the whole batch has been received
+        return appended;
+    }
+
+    // Consume complete fields while the remaining chunks are in transit
+    // Errors are reported by tx_check_partial, or by tx_parse once the last chunk has arrived
+    // Data staged for flash is not readable yet, it is parsed once its page has been written
+    tx_set_parser_segments();
+    ctx_partial_err = parser_parseChunk(&ctx_parsed_tx,
+                                        segbuffer_get_ram_buffer()->data,
+                                        segbuffer_get_readable_length());
+
+    return appended;
 }
 
-uint8_t *tx_get_buffer() {
-    return buffering_get_buffer()->data;
+const char *tx_check_partial(bool_t isMainnet) {
+    parser_error_t err = ctx_partial_err;
+    if (err == parser_ok) {
+        err = parser_validateHeader(&ctx_parsed_tx, isMainnet);
+    }
+
+    if (err != parser_ok) {
+        return parser_getErrorDescription(err);
+    }
+
+    return NULL;
 }
 
 const char *tx_parse(bool_t isMainnet) {
-    uint8_t err = parser_parse(
+    segbuffer_flush();
+
+    if (tx_digest_state == tx_digest_updating && arena_get_phase() == arena_phase_receive) {
+        crypto_digestFinal(tx_digest);
+        tx_digest_state = tx_digest_done;
+    } else {
+        tx_digest_state = tx_digest_none;
+    }
+    arena_enter(arena_phase_review);
+
+    // Only the tail that was not consumed while receiving is parsed here
+    tx_set_parser_segments();
+    uint8_t err = parser_parseEnd(
         &ctx_parsed_tx,
-        tx_get_buffer(),
+        segbuffer_get_ram_buffer()->data,
         tx_get_buffer_length());
 
     if (err != parser_ok) {
@@ -90,8 +236,221 @@ const char *tx_parse(bool_t isMainnet) {
     return NULL;
 }
 
+parser_error_t tx_batch_select(uint8_t idx) {
+    if (tx_batch.current == idx && parser_getNumItems(&ctx_parsed_tx) != 0) {
+        return parser_ok;
+    }
+
+    segments_t slice;
+    tx_get_slice(tx_batch.offset[idx], tx_batch.length[idx], &slice);
+    tx_set_parser_segments();
+
+    parser_error_t err = parser_parse(&ctx_parsed_tx, (uint8_t *) slice.head, tx_batch.length[idx]);
+    if (err != parser_ok) {
+        return err;
+    }
+
+    err = parser_validate(tx_batch.isMainnet);
+    if (err != parser_ok) {
+        return err;
+    }
+
+    tx_batch.current = idx;
+    return parser_ok;
+}
+
+const char *tx_batch_split(bool_t isMainnet) {
+    const uint32_t bufferLen = tx_get_buffer_length();
+    tx_set_parser_segments();
+
+    uint32_t offset = 0;
+    uint16_t totalItems = TX_BATCH_SUMMARY_ITEMS;
+    while (offset < bufferLen) {
+        if (tx_batch.count >= TX_BATCH_MAX) {
+            return "Too many transactions";
+        }
+
+        if (offset + TX_BATCH_LEN_BYTES > bufferLen) {
+            return "Unexpected buffer end";
+        }
+
+        const uint16_t length = (tx_get_byte(offset) << 8u) | tx_get_byte(offset + 1);
+        offset += TX_BATCH_LEN_BYTES;
+        if (length == 0 || offset + length > bufferLen) {
+            return "Unexpected buffer end";
+        }
+
+        const uint8_t idx = tx_batch.count;
+        tx_batch.offset[idx] = offset;
+        tx_batch.length[idx] = length;
+        tx_batch.current = idx;
+        offset += length;
+
+        // Every transaction is validated before anything is shown
+        segments_t slice;
+        tx_get_slice(tx_batch.offset[idx], length, &slice);
+        parser_error_t err = parser_parse(&ctx_parsed_tx, (uint8_t *) slice.head, length);
+        if (err == parser_ok) {
+            err = parser_validate(isMainnet);
+        }
+        if (err != parser_ok) {
+            return parser_getErrorDescription(err);
+        }
+
+        tx_batch.numItems[idx] = parser_getNumItems(&ctx_parsed_tx);
+        totalItems += tx_batch.numItems[idx];
+        tx_batch.count++;
+    }
+
+    if (tx_batch.count == 0) {
+        return "No transactions";
+    }
+
+    // Display indexes are signed 8 bit values
+    if (totalItems > INT8_MAX) {
+        return "Too many items";
+    }
+
+    return NULL;
+}
+
+const char *tx_batch_parse(bool_t isMainnet) {
+    segbuffer_flush();
+    arena_enter(arena_phase_review);
+
+    tx_batch.isMainnet = isMainnet;
+    tx_batch.count = 0;
+
+    if (!tx_batch.active) {
+        // The first chunk was not sent as a batch
+        return "Unexpected batch";
+    }
+
+    const char *error_msg = tx_batch_split(isMainnet);
+    if (error_msg != NULL) {
+        // Nothing in a rejected batch can be reviewed or signed
+        tx_batch.count = 0;
+    }
+
+    return error_msg;
+}
+
+uint8_t tx_batch_count() {
+    if (!tx_batch.active) {
+        return 0;
+    }
+    return tx_batch.count;
+}
+
+bool_t tx_batch_get(uint8_t idx, segments_t *message) {
+    if (idx >= tx_batch_count()) {
+        return bool_false;
+    }
+
+    tx_get_slice(tx_batch.offset[idx], tx_batch.length[idx], message);
+    return bool_true;
+}
+
 uint8_t tx_getNumItems() {
-    return parser_getNumItems(&ctx_parsed_tx);
+    if (tx_batch_count() == 0) {
+        return parser_getNumItems(&ctx_parsed_tx);
+    }
+
+    uint8_t numItems = TX_BATCH_SUMMARY_ITEMS;
+    for (uint8_t i = 0; i < tx_batch.count; i++) {
+        numItems += tx_batch.numItems[i];
+    }
+    return numItems;
+}
+
+// Finds the transaction an item after the batch summary belongs to
+bool_t tx_batch_findItem(int8_t displayIdx, uint8_t *txIdx, uint8_t *itemIdx) {
+    *itemIdx = displayIdx - TX_BATCH_SUMMARY_ITEMS;
+    *txIdx = 0;
+    while (*txIdx < tx_batch.count && *itemIdx >= tx_batch.numItems[*txIdx]) {
+        *itemIdx -= tx_batch.numItems[*txIdx];
+        (*txIdx)++;
+    }
+    return *txIdx < tx_batch.count ? bool_true : bool_false;
+}
+
+tx_error_t tx_batch_getItemPageCount(int8_t displayIdx, uint16_t outValueLen, uint8_t *pageCount) {
+    *pageCount = 0;
+    if (displayIdx < 0) {
+        return tx_no_data;
+    }
+
+    if (displayIdx < TX_BATCH_SUMMARY_ITEMS) {
+        *pageCount = 1;
+        return tx_no_error;
+    }
+
+    uint8_t txIdx, itemIdx;
+    if (!tx_batch_findItem(displayIdx, &txIdx, &itemIdx)) {
+        return tx_no_data;
+    }
+
+    // Only parses the transaction if it is not the selected one
+    tx_error_t err = (tx_error_t) tx_batch_select(txIdx);
+    if (err != tx_no_error) {
+        return err;
+    }
+
+    return (tx_error_t) parser_getItemPageCount(itemIdx, outValueLen, pageCount);
+}
+
+tx_error_t tx_batch_getItem(int8_t displayIdx,
+                            char *outKey, uint16_t outKeyLen,
+                            char *outValue, uint16_t outValueLen,
+                            uint8_t pageIdx, uint8_t *pageCount) {
+    *pageCount = 0;
+    if (displayIdx < 0) {
+        return tx_no_data;
+    }
+
+    if (displayIdx < TX_BATCH_SUMMARY_ITEMS) {
+        *pageCount = 1;
+        snprintf(outKey, outKeyLen, "Batch");
+        snprintf(outValue, outValueLen, "%d transactions", tx_batch.count);
+        return tx_no_error;
+    }
+
+    uint8_t txIdx, itemIdx;
+    if (!tx_batch_findItem(displayIdx, &txIdx, &itemIdx)) {
+        return tx_no_data;
+    }
+
+    tx_error_t err = (tx_error_t) tx_batch_select(txIdx);
+    if (err != tx_no_error) {
+        return err;
+    }
+
+    err = (tx_error_t) parser_getItem(&ctx_parsed_tx,
+                                      itemIdx,
+                                      outKey, outKeyLen,
+                                      outValue, outValueLen,
+                                      pageIdx, pageCount);
+
+    // Prefix the key with the transaction number
+    char prefix[12];
+    snprintf(prefix, sizeof(prefix), "Tx %d/%d ", txIdx + 1, tx_batch.count);
+    const uint16_t prefixLen = strlen(prefix);
+    const uint16_t keyLen = strlen(outKey);
+    if (prefixLen + keyLen < outKeyLen) {
+        MEMMOVE(outKey + prefixLen, outKey, keyLen + 1);
+        MEMCPY(outKey, prefix, prefixLen);
+    }
+
+    return err;
+}
+
+tx_error_t tx_getItemPageCount(int8_t displayIdx, uint16_t outValueLen, uint8_t *pageCount) {
+    if (tx_batch_count() != 0) {
+        return tx_batch_getItemPageCount(displayIdx, outValueLen, pageCount);
+    }
+
+    // parser_ok and parser_no_data have the same values as tx_no_error and tx_no_data
+    return (tx_error_t) parser_getItemPageCount(displayIdx, outValueLen, pageCount);
 }
 
 tx_error_t tx_getItem(int8_t displayIdx,
@@ -100,11 +459,18 @@ tx_error_t tx_getItem(int8_t displayIdx,
                       uint8_t pageIdx, uint8_t *pageCount) {
     tx_error_t err = tx_no_error;
 
-    err = (tx_error_t) parser_getItem(&ctx_parsed_tx,
-                                      displayIdx,
-                                      outKey, outKeyLen,
-                                      outValue, outValueLen,
-                                      pageIdx, pageCount);
+    if (tx_batch_count() != 0) {
+        err = tx_batch_getItem(displayIdx,
+                               outKey, outKeyLen,
+                               outValue, outValueLen,
+                               pageIdx, pageCount);
+    } else {
+        err = (tx_error_t) parser_getItem(&ctx_parsed_tx,
+                                          displayIdx,
+                                          outKey, outKeyLen,
+                                          outValue, outValueLen,
+                                          pageIdx, pageCount);
+    }
 
     if (*pageCount > 1) {
         uint8_t keyLen = strlen(outKey);
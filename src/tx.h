@@ -23,6 +23,16 @@ typedef enum {
     tx_no_data = 1,
 } tx_error_t;
 
+// Maximum number of transactions in a batch
+#if defined(TARGET_NANOX)
+#define TX_BATCH_MAX 16
+#else
+#define TX_BATCH_MAX 4
+#endif
+
+// Each transaction in a batch is prefixed by its length
+#define TX_BATCH_LEN_BYTES 2
+
 void tx_initialize();
 
 /// Clears the transaction buffer
@@ -30,6 +40,7 @@ void tx_reset();
 
 /// Appends buffer to the end of the current transaction buffer
 /// Transaction buffer will grow until it reaches the maximum allowed size
+/// Fields that are already complete are parsed as data arrives
 /// \param buffer
 /// \param length
 /// \return It returns an error message if the buffer is too small.
@@ -39,18 +50,56 @@ uint32_t tx_append(unsigned char *buffer, uint32_t length);
 /// \return
 uint32_t tx_get_buffer_length();
 
-/// Returns the raw json transaction buffer
+/// Returns the raw transaction buffer
+/// The beginning is kept in RAM, the rest (if any) continues in flash
+void tx_get_message(segments_t *message);
+
+/// Returns the end of the RAM transaction buffer that the transaction does not use
+/// It holds data that lives while the transaction is reviewed, anything appended overwrites it
+/// \param length receives the number of bytes available, 0 once the transaction continues in flash
 /// \return
-uint8_t *tx_get_buffer();
+uint8_t *tx_get_scratch(uint16_t *length);
+
+/// Returns the SHA-512 digest of the transaction buffer, computed while chunks were received
+/// \return NULL if it is not available (e.g. batch mode), the buffer must then be hashed
+const uint8_t *tx_get_digest();
+
+/// Checks the chunks received so far, so that a bad transaction is rejected before it is complete
+/// Only the header and the fields that have been fully received are checked
+/// \return It returns NULL if no error has been found yet or error message otherwise.
+const char *tx_check_partial(bool_t isMainnet);
 
 /// Parse message stored in transaction buffer
 /// This function should be called as soon as full buffer data is loaded.
 /// \return It returns NULL if json is valid or error message otherwise.
 const char *tx_parse(bool_t isMainnet);
 
+/// Switches the transaction buffer to batch mode
+/// The buffer holds several transactions, each one prefixed by its length (2 bytes, big endian)
+void tx_batch_begin();
+
+/// Splits and parses every transaction in the batch buffer
+/// This function should be called as soon as full buffer data is loaded.
+/// \return It returns NULL if all transactions are valid or error message otherwise.
+const char *tx_batch_parse(bool_t isMainnet);
+
+/// Returns the number of transactions in a parsed batch, 0 when not in batch mode
+uint8_t tx_batch_count();
+
+/// Returns the raw bytes of a transaction in the batch
+bool_t tx_batch_get(uint8_t idx, segments_t *message);
+
 /// Return the number of items in the transaction
+/// In batch mode, this covers the batch summary and the items of every transaction
 uint8_t tx_getNumItems();
 
+/// Gets the number of pages of an item, without rendering it
+/// \param displayIdx
+/// \param outValueLen size of the value buffer given to tx_getItem
+/// \param pageCount
+/// \return tx_no_data if there is no such item
+tx_error_t tx_getItemPageCount(int8_t displayIdx, uint16_t outValueLen, uint8_t *pageCount);
+
 /// Gets an specific item from the transaction (including paging)
 tx_error_t tx_getItem(int8_t displayIdx,
                            char *outKey, uint16_t outKeyLen,
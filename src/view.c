@@ -29,7 +29,6 @@
 #include <string.h>
 #include <stdio.h>
 
-view_t viewdata;
 const char *address;
 
 void h_address_accept(unsigned int _) {
@@ -46,6 +45,11 @@ void h_error_accept(unsigned int _) {
     app_reply_address();
 }
 
+void h_exit(unsigned int _) {
+    UNUSED(_);
+    app_exit();
+}
+
 void h_sign_accept(unsigned int _) {
     UNUSED(_);
 
@@ -67,54 +71,6 @@ void h_sign_reject(unsigned int _) {
     io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, 2);
 }
 
-void h_review_init() {
-    viewdata.idx = 0;
-    viewdata.pageIdx = 0;
-    viewdata.pageCount = 1;
-}
-
-void h_review_increase() {
-    viewdata.pageIdx++;
-    if (viewdata.pageIdx >= viewdata.pageCount) {
-        viewdata.idx++;
-        viewdata.pageIdx = 0;
-    }
-}
-
-void h_review_decrease() {
-    viewdata.pageIdx--;
-    if (viewdata.pageIdx < 0) {
-        viewdata.idx--;
-        viewdata.pageIdx = 0;
-    }
-}
-
-view_error_t h_review_update_data() {
-    tx_error_t err = tx_no_error;
-
-    do {
-        err = tx_getItem(viewdata.idx,
-                         viewdata.key, MAX_CHARS_PER_KEY_LINE,
-                         viewdata.value, MAX_CHARS_PER_VALUE1_LINE,
-                         viewdata.pageIdx, &viewdata.pageCount);
-
-        if (err == tx_no_data) {
-            return view_no_data;
-        }
-
-        if (viewdata.pageCount == 0) {
-            h_review_increase();
-        }
-    } while (viewdata.pageCount == 0);
-
-    if (err != tx_no_error) {
-        return view_error_detected;
-    }
-
-    splitValueField();
-    return view_no_error;
-}
-
 void io_seproxyhal_display(const bagl_element_t *element) {
     io_seproxyhal_display_default((bagl_element_t *) element);
 }
@@ -128,12 +84,14 @@ void view_idle_show(unsigned int ignored) {
 }
 
 void view_address_show() {
+    arena_enter(arena_phase_review);
     // Address has been placed in the output buffer
     address = (char *) (G_io_apdu_buffer + 32);
     view_address_show_impl();
 }
 
 void view_error_show() {
+    arena_enter(arena_phase_review);
     snprintf(viewdata.key, MAX_CHARS_PER_KEY_LINE, "ERROR");
     snprintf(viewdata.value, MAX_CHARS_PER_VALUE1_LINE, "SHOWING DATA");
     splitValueField();
@@ -141,5 +99,6 @@ void view_error_show() {
 }
 
 void view_sign_show() {
+    arena_enter(arena_phase_review);
     view_sign_show_impl();
 }
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <stdint.h>
+#include "lib/arena.h"
 
 #define MENU_MAIN_APP_LINE1 "IOV"
 
@@ -30,6 +31,7 @@
 #define MAX_CHARS_PER_KEY_LINE      64
 #define MAX_CHARS_PER_VALUE1_LINE   4096
 #define MAX_CHARS_HEXMESSAGE        160
+#define MAX_CHARS_PREFETCH_VALUE    256     // longer values are rendered when they are shown
 #define CUR_FLOW G_ux.flow_stack[G_ux.stack_count-1]
 #else
 #define MAX_CHARS_PER_KEY_LINE      (32+1)
@@ -37,6 +39,7 @@
 #define MAX_CHARS_PER_VALUE1_LINE   (2*MAX_CHARS_PER_VALUE_LINE+1)
 #define MAX_CHARS_PER_VALUE2_LINE   (MAX_CHARS_PER_VALUE_LINE+1)
 #define MAX_CHARS_HEXMESSAGE        40
+#define MAX_CHARS_PREFETCH_VALUE    MAX_CHARS_PER_VALUE1_LINE
 #endif
 
 extern const char *address;
@@ -52,7 +55,9 @@ typedef struct {
     uint8_t pageCount;
 } view_t;
 
-extern view_t viewdata;
+// Only used while something is shown, kept in the review phase of the arena (see arena_enter)
+#define viewdata (*ARENA_AT(view_t, ARENA_VIEW_OFFSET))
+ARENA_CHECK(view_t, ARENA_VIEW_OFFSET, ARENA_VIEW_SIZE);
 
 typedef enum {
     view_no_error = 0,
@@ -91,6 +96,8 @@ void h_address_accept(unsigned int _);
 
 void h_error_accept(unsigned int _);
 
+void h_exit(unsigned int _);
+
 void h_sign_accept(unsigned int _);
 
 void h_sign_reject(unsigned int _);
@@ -102,3 +109,5 @@ void h_review_increase();
 void h_review_decrease();
 
 view_error_t h_review_update_data();
+
+void h_review_prefetch();
@@ -0,0 +1,244 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+
+#include "view_internal.h"
+#include "tx.h"
+#include "zxmacros.h"
+
+#include <string.h>
+
+// Review generator
+// The review is a cursor over (item, page) that the button handlers move. Once a screen is shown,
+// the screens on each side of it are rendered into the prefetch slots, so the next move only copies
+// a slot into the view. The screen that is left is kept in the other slot to serve an immediate
+// move back. It does not depend on the UX, the simulator drives the review with the same code
+// The slots use the end of the RAM transaction buffer, past the transaction under review. Screens
+// are rendered when shown if it is too small or the transaction changed since the review started
+
+#define VIEW_PREFETCH_SLOTS 2
+
+typedef struct {
+    char key[MAX_CHARS_PER_KEY_LINE];
+    char value[MAX_CHARS_PREFETCH_VALUE];   // not split in lines
+    int8_t idx;
+    int8_t pageIdx;
+    uint8_t pageCount;
+    uint8_t ready;
+} view_screen_t;
+
+typedef struct {
+    view_screen_t slot[VIEW_PREFETCH_SLOTS];
+} view_prefetch_t;
+
+typedef struct {
+    uint32_t txLength;                      // of the transaction under review
+    int8_t shownIdx;                        // negative when the view does not show a review screen
+    int8_t shownPageIdx;
+    uint8_t shownPageCount;
+} view_review_t;
+
+view_review_t viewreview;
+
+// Slots are placed at any byte offset of the transaction buffer
+_Static_assert(__alignof__(view_prefetch_t) == 1, "view_prefetch_t must not need alignment");
+
+// \return NULL if the slots cannot be used
+__Z_INLINE view_prefetch_t *h_review_slots() {
+    if (arena_get_phase() != arena_phase_review || tx_get_buffer_length() != viewreview.txLength) {
+        return NULL;
+    }
+
+    uint16_t length;
+    uint8_t *scratch = tx_get_scratch(&length);
+    if (length < sizeof(view_prefetch_t)) {
+        return NULL;
+    }
+    return (view_prefetch_t *) scratch;
+}
+
+__Z_INLINE void h_review_next(int8_t *idx, int8_t *pageIdx, uint8_t pageCount) {
+    (*pageIdx)++;
+    if (*pageIdx >= pageCount) {
+        (*idx)++;
+        *pageIdx = 0;
+    }
+}
+
+__Z_INLINE void h_review_prev(int8_t *idx, int8_t *pageIdx) {
+    (*pageIdx)--;
+    if (*pageIdx < 0) {
+        (*idx)--;
+        *pageIdx = 0;
+    }
+}
+
+__Z_INLINE view_screen_t *h_review_findSlot(view_prefetch_t *prefetch, int8_t idx, int8_t pageIdx) {
+    if (prefetch == NULL) {
+        return NULL;
+    }
+    for (uint8_t i = 0; i < VIEW_PREFETCH_SLOTS; i++) {
+        view_screen_t *screen = &prefetch->slot[i];
+        if (screen->ready && screen->idx == idx && screen->pageIdx == pageIdx) {
+            return screen;
+        }
+    }
+    return NULL;
+}
+
+__Z_INLINE view_screen_t *h_review_otherSlot(view_prefetch_t *prefetch, const view_screen_t *screen) {
+    return screen == &prefetch->slot[0] ? &prefetch->slot[1] : &prefetch->slot[0];
+}
+
+// Copies the screen that is shown to a slot, the view splits values in lines so they are joined again
+void h_review_keepShown(view_screen_t *dst) {
+    dst->ready = 0;
+    if (viewreview.shownIdx < 0) {
+        return;
+    }
+
+#if defined(TARGET_NANOS)
+    const char *value2 = viewdata.value2;
+#else
+    const char *value2 = "";
+#endif
+    if (strlen(viewdata.value) + strlen(value2) >= sizeof(dst->value)) {
+        return;
+    }
+
+    strcpy(dst->key, viewdata.key);
+    strcpy(dst->value, viewdata.value);
+    strcat(dst->value, value2);
+    dst->idx = viewreview.shownIdx;
+    dst->pageIdx = viewreview.shownPageIdx;
+    dst->pageCount = viewreview.shownPageCount;
+    dst->ready = 1;
+}
+
+// Renders a screen in a slot, unless it is already in one. The slot holding keep is not used
+void h_review_prefetchScreen(view_prefetch_t *prefetch, int8_t idx, int8_t pageIdx, const view_screen_t *keep) {
+    if (prefetch == NULL || h_review_findSlot(prefetch, idx, pageIdx) != NULL) {
+        return;
+    }
+
+    uint8_t pageCount;
+    if (tx_getItemPageCount(idx, MAX_CHARS_PREFETCH_VALUE, &pageCount) != tx_no_error || pageIdx >= pageCount) {
+        return;
+    }
+
+    // A shorter slot pages the value differently than the view, it is rendered when shown
+    if (MAX_CHARS_PREFETCH_VALUE < MAX_CHARS_PER_VALUE1_LINE && pageCount > 1) {
+        return;
+    }
+
+    view_screen_t *screen = &prefetch->slot[0];
+    if (screen == keep) {
+        screen = h_review_otherSlot(prefetch, screen);
+    }
+
+    screen->ready = 0;
+    screen->idx = idx;
+    screen->pageIdx = pageIdx;
+    const tx_error_t err = tx_getItem(idx,
+                                      screen->key, sizeof(screen->key),
+                                      screen->value, sizeof(screen->value),
+                                      pageIdx, &screen->pageCount);
+
+    // Errors are reported if the screen is shown
+    if (err != tx_no_error) {
+        return;
+    }
+
+    screen->ready = 1;
+}
+
+void h_review_init() {
+    viewdata.idx = 0;
+    viewdata.pageIdx = 0;
+    viewdata.pageCount = 1;
+
+    viewreview.txLength = tx_get_buffer_length();
+    viewreview.shownIdx = -1;
+
+    view_prefetch_t *prefetch = h_review_slots();
+    if (prefetch != NULL) {
+        prefetch->slot[0].ready = 0;
+        prefetch->slot[1].ready = 0;
+    }
+}
+
+void h_review_increase() {
+    h_review_next(&viewdata.idx, &viewdata.pageIdx, viewdata.pageCount);
+}
+
+void h_review_decrease() {
+    h_review_prev(&viewdata.idx, &viewdata.pageIdx);
+}
+
+view_error_t h_review_update_data() {
+    if (viewdata.idx < 0 || viewdata.idx >= tx_getNumItems()) {
+        return view_no_data;
+    }
+
+    view_prefetch_t *prefetch = h_review_slots();
+    const view_screen_t *screen = h_review_findSlot(prefetch, viewdata.idx, viewdata.pageIdx);
+    if (screen != NULL) {
+        h_review_keepShown(h_review_otherSlot(prefetch, screen));
+        strcpy(viewdata.key, screen->key);
+        strcpy(viewdata.value, screen->value);
+        viewdata.pageCount = screen->pageCount;
+    } else {
+        viewreview.shownIdx = -1;
+
+        tx_error_t err = tx_getItem(viewdata.idx,
+                                    viewdata.key, MAX_CHARS_PER_KEY_LINE,
+                                    viewdata.value, MAX_CHARS_PER_VALUE1_LINE,
+                                    viewdata.pageIdx, &viewdata.pageCount);
+
+        if (err == tx_no_data) {
+            return view_no_data;
+        }
+
+        if (err != tx_no_error) {
+            return view_error_detected;
+        }
+    }
+
+    viewreview.shownIdx = viewdata.idx;
+    viewreview.shownPageIdx = viewdata.pageIdx;
+    viewreview.shownPageCount = viewdata.pageCount;
+
+    splitValueField();
+    return view_no_error;
+}
+
+void h_review_prefetch() {
+    view_prefetch_t *prefetch = h_review_slots();
+    if (prefetch == NULL || viewreview.shownIdx < 0) {
+        return;
+    }
+
+    int8_t nextIdx = viewreview.shownIdx;
+    int8_t nextPageIdx = viewreview.shownPageIdx;
+    h_review_next(&nextIdx, &nextPageIdx, viewreview.shownPageCount);
+
+    int8_t prevIdx = viewreview.shownIdx;
+    int8_t prevPageIdx = viewreview.shownPageIdx;
+    h_review_prev(&prevIdx, &prevPageIdx);
+
+    // Reviews mostly move forward, the previous screen is usually the one kept when moving here
+    h_review_prefetchScreen(prefetch, nextIdx, nextPageIdx, h_review_findSlot(prefetch, prevIdx, prevPageIdx));
+    h_review_prefetchScreen(prefetch, prevIdx, prevPageIdx, h_review_findSlot(prefetch, nextIdx, nextPageIdx));
+}
@@ -40,7 +40,7 @@ ux_state_t ux;
 const ux_menu_entry_t menu_main[] = {
     {NULL, NULL, 0, &C_icon_app, MENU_MAIN_APP_LINE1, MENU_MAIN_APP_LINE2, 33, 12},
     {NULL, NULL, 0, NULL, "v"APPVERSION, NULL, 0, 0},
-    {NULL, os_sched_exit, 0, &C_icon_dashboard, "Quit", NULL, 50, 29},
+    {NULL, h_exit, 0, &C_icon_dashboard, "Quit", NULL, 50, 29},
     UX_MENU_END
 };
 
@@ -141,6 +141,8 @@ void h_review_button_left() {
     switch(err) {
         case view_no_error:
             view_review_show();
+            // The screen is being drawn, render the ones next to it meanwhile
+            h_review_prefetch();
             break;
         case view_no_data:
             view_sign_show_s();
@@ -162,6 +164,7 @@ void h_review_button_right() {
     switch(err) {
         case view_no_error:
             view_review_show();
+            h_review_prefetch();
             break;
         case view_no_data:
             view_sign_show_s();
@@ -221,6 +224,7 @@ void view_sign_show_impl() {
     switch(err) {
         case view_no_error:
             view_review_show();
+            h_review_prefetch();
             break;
         case view_no_data:
             view_sign_show_s();
@@ -41,7 +41,7 @@ uint8_t flow_inside_loop;
 
 UX_FLOW_DEF_NOCB(ux_idle_flow_1_step, pbb, { &C_icon_app, MENU_MAIN_APP_LINE1, MENU_MAIN_APP_LINE2,});
 UX_FLOW_DEF_NOCB(ux_idle_flow_3_step, bn, { "Version", APPVERSION, });
-UX_FLOW_DEF_VALID(ux_idle_flow_4_step, pb, os_sched_exit(-1), { &C_icon_dashboard, "Quit",});
+UX_FLOW_DEF_VALID(ux_idle_flow_4_step, pb, h_exit(0), { &C_icon_dashboard, "Quit",});
 const ux_flow_step_t *const ux_idle_flow [] = {
   &ux_idle_flow_1_step,
   &ux_idle_flow_3_step,
@@ -123,6 +123,8 @@ void h_review_loop_start() {
     }
 
     ux_flow_next();
+    // The screen is being drawn, render the ones next to it meanwhile
+    h_review_prefetch();
 }
 
 void h_review_loop_inside() {
@@ -169,6 +171,7 @@ void h_review_loop_end() {
     CUR_FLOW.prev_index = CUR_FLOW.index-2;
     CUR_FLOW.index--;
     ux_flow_relayout();
+    h_review_prefetch();
 }
 
 void splitValueField() {}
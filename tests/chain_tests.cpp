@@ -0,0 +1,56 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+#include "chain.h"
+#include "iov.h"
+
+namespace {
+
+    TEST(Chain, RegisteredFoundBySlot) {
+        bool slotUsed[CHAIN_SLOTS] = {};
+        for (uint8_t idx = 0; idx < CHAIN_COUNT; idx++) {
+            if (idx == CHAIN_OTHER_TESTNET) {
+                continue;
+            }
+            const chain_t *chain = chain_get(idx);
+            const auto *id = (const uint8_t *) chain->chainID;
+            const uint32_t hash = chain_hash(id, chain->chainIDLen);
+
+            EXPECT_EQ(hash, chain->hash) << chain->chainID << " has a stale hash";
+            EXPECT_EQ(strlen(chain->chainID), chain->chainIDLen) << chain->chainID << " has a wrong length";
+            EXPECT_FALSE(slotUsed[hash & (CHAIN_SLOTS - 1)]) << chain->chainID << " shares a slot";
+            EXPECT_EQ(idx, chain_lookup(id, chain->chainIDLen)) << chain->chainID << " not found";
+            slotUsed[hash & (CHAIN_SLOTS - 1)] = true;
+        }
+    }
+
+    TEST(Chain, NearMissesAreTestnets) {
+        const char *others[] = {"iov-mainne", "iov-mainnet2", "iov-mainneT", "iov-lovenet ", "iov-boarnet", ""};
+        for (const char *other : others) {
+            EXPECT_EQ(CHAIN_OTHER_TESTNET, chain_lookup((const uint8_t *) other, strlen(other)))
+                                << other << " should not be registered";
+        }
+    }
+
+    TEST(Chain, HRP) {
+        EXPECT_STREQ(APP_MAINNET_HRP, chain_get(CHAIN_IOV_MAINNET)->hrp);
+        EXPECT_STREQ(APP_TESTNET_HRP, chain_get(CHAIN_IOV_LOVENET)->hrp);
+        EXPECT_STREQ(APP_TESTNET_HRP, chain_get(CHAIN_COUNT)->hrp) << "Out of range is another testnet";
+    }
+}
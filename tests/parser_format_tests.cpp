@@ -0,0 +1,246 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "tx_builder.h"
+
+#include "parser.h"
+
+namespace {
+
+    parser_error_t decode(const bench::bytes_t &data, uint64_t *value, uint16_t *consumed) {
+        parser_context_t ctx;
+        parser_init_context(&ctx, data.data(), data.size());
+        const parser_error_t err = _readRawVarint(&ctx, value);
+        *consumed = ctx.lastConsumed;
+        return err;
+    }
+
+    std::vector<uint64_t> varint_values() {
+        std::vector<uint64_t> values = {0, UINT64_MAX, 999999999, 999999999999999ull};
+        for (uint8_t bit = 0; bit < 64; bit++) {
+            values.push_back((1ull << bit) - 1);
+            values.push_back(1ull << bit);
+            values.push_back((1ull << bit) + 1);
+        }
+        return values;
+    }
+
+    TEST(Varint, Decodes) {
+        for (const uint64_t want : varint_values()) {
+            bench::bytes_t data;
+            bench::pb_varint(data, want);
+            const size_t len = data.size();
+            // Anything after the varint is left alone
+            data.insert(data.end(), 12, 0x81);
+
+            uint64_t value = 0;
+            uint16_t consumed = 0;
+            ASSERT_EQ(parser_ok, decode(data, &value, &consumed)) << want;
+            EXPECT_EQ(want, value);
+            EXPECT_EQ(len, consumed) << want;
+        }
+    }
+
+    TEST(Varint, Truncated) {
+        for (const uint64_t want : varint_values()) {
+            bench::bytes_t data;
+            bench::pb_varint(data, want);
+            for (size_t len = 0; len < data.size(); len++) {
+                uint64_t value;
+                uint16_t consumed;
+                const bench::bytes_t truncated(data.begin(), data.begin() + len);
+                EXPECT_EQ(parser_unexpected_buffer_end, decode(truncated, &value, &consumed))
+                                    << want << " truncated to " << len << " bytes";
+                EXPECT_EQ(0, consumed);
+            }
+        }
+    }
+
+    TEST(Varint, NonCanonical) {
+        uint64_t value;
+        uint16_t consumed;
+        EXPECT_EQ(parser_ok, decode({0x80, 0x80, 0x01}, &value, &consumed));
+        EXPECT_EQ(16384u, value);
+        EXPECT_EQ(3, consumed);
+    }
+
+    TEST(Varint, Overflow) {
+        uint64_t value;
+        uint16_t consumed;
+        EXPECT_EQ(parser_value_out_of_range,
+                  decode({0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x02}, &value, &consumed));
+        EXPECT_EQ(0, consumed);
+    }
+
+    TEST(Varint, TooLong) {
+        uint64_t value;
+        uint16_t consumed;
+        EXPECT_EQ(parser_unexpected_buffer_end,
+                  decode({0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01}, &value, &consumed))
+                            << "No more than 10 bytes";
+        EXPECT_EQ(0, consumed);
+    }
+
+    std::string format(int64_t whole, int64_t fractional, uint8_t flags, uint16_t outLen = 64) {
+        parser_coin_t coin = {};
+        coin.whole = whole;
+        coin.fractional = fractional;
+        char out[64];
+        const parser_error_t err = parser_formatCoin(out, outLen, &coin, flags);
+        if (err != parser_ok) {
+            return parser_getErrorDescription(err);
+        }
+        return out;
+    }
+
+    TEST(Amount, Flags) {
+        EXPECT_EQ("1.5", format(1, 500000000, PARSER_AMOUNT_FRIENDLY | PARSER_AMOUNT_TRIM));
+        EXPECT_EQ("12", format(12, 0, PARSER_AMOUNT_FRIENDLY | PARSER_AMOUNT_TRIM));
+        EXPECT_EQ("0.000000001", format(0, 1, PARSER_AMOUNT_FRIENDLY | PARSER_AMOUNT_TRIM));
+        EXPECT_EQ("999.000000010", format(999, 10, PARSER_AMOUNT_FRIENDLY | PARSER_AMOUNT_GROUP));
+        EXPECT_EQ("1,000.000000000", format(1000, 0, PARSER_AMOUNT_FRIENDLY | PARSER_AMOUNT_GROUP));
+        EXPECT_EQ("999,999,999,999,999.99",
+                  format(999999999999999, 990000000,
+                         PARSER_AMOUNT_FRIENDLY | PARSER_AMOUNT_GROUP | PARSER_AMOUNT_TRIM));
+        EXPECT_EQ("1234567000000005", format(1234567, 5, PARSER_AMOUNT_GROUP | PARSER_AMOUNT_TRIM))
+                            << "Trim and group only apply to friendly amounts";
+    }
+
+    TEST(Amount, DefaultFormats) {
+        // Every number of whole and fractional digits, with and without trailing zeros
+        for (int w = 0; w <= IOV_WHOLE_DIGITS; w++) {
+            for (int f = 0; f <= IOV_FRAC_DIGITS; f++) {
+                int64_t wMax = 1, fMax = 1;
+                for (int i = 0; i < w; i++) wMax *= 10;
+                for (int i = 0; i < f; i++) fMax *= 10;
+
+                const int64_t wholes[] = {w == 0 ? 0 : wMax / 10, wMax - 1, wMax / 10 * 7 + wMax / 30};
+                const int64_t fracs[] = {f == 0 ? 0 : fMax / 10, fMax - 1, fMax / 10 * 3 + fMax / 70};
+                for (const int64_t whole : wholes) {
+                    for (const int64_t fractional : fracs) {
+                        char want[64];
+                        if (whole == 0) {
+                            snprintf(want, sizeof(want), "%" PRId64, fractional);
+                        } else {
+                            snprintf(want, sizeof(want), "%" PRId64 "%09" PRId64, whole, fractional);
+                        }
+                        EXPECT_EQ(want, format(whole, fractional, 0));
+
+                        snprintf(want, sizeof(want), "%" PRId64 ".%09" PRId64, whole, fractional);
+                        EXPECT_EQ(want, format(whole, fractional, PARSER_AMOUNT_FRIENDLY));
+                    }
+                }
+            }
+        }
+    }
+
+    TEST(Amount, OutputLength) {
+        // 19 whole digits, a dot, 9 fractional digits and the terminator
+        EXPECT_EQ(parser_getErrorDescription(parser_unexpected_buffer_end),
+                  format(INT64_MAX, 0, PARSER_AMOUNT_FRIENDLY, 29));
+        EXPECT_EQ("9223372036854775807.000000000", format(INT64_MAX, 0, PARSER_AMOUNT_FRIENDLY, 30));
+    }
+
+    TEST(Amount, FractionalOutOfRange) {
+        EXPECT_EQ(parser_getErrorDescription(parser_unexpected_buffer_end),
+                  format(INT64_MAX, 1000000000, PARSER_AMOUNT_FRIENDLY));
+    }
+
+    TEST(Paging, Unpaged) {
+        uint8_t in[TX_MEMOLEN_MAX];
+        for (size_t i = 0; i < sizeof(in); i++) {
+            in[i] = 'a' + i % 26;
+        }
+
+        std::vector<char> out(256);
+        for (uint16_t outLen = 1; outLen < out.size(); outLen++) {
+            for (uint16_t inLen = 0; inLen <= sizeof(in); inLen++) {
+                memset(out.data(), 'x', out.size());
+                const parser_error_t err = parser_arrayToString(out.data(), outLen, in, inLen, 0, nullptr);
+                if (inLen > outLen - 1) {
+                    EXPECT_EQ(parser_unexpected_buffer_end, err) << "in " << inLen << ", out " << outLen;
+                    continue;
+                }
+                ASSERT_EQ(parser_ok, err) << "in " << inLen << ", out " << outLen;
+                EXPECT_EQ(std::string((const char *) in, inLen), out.data()) << "in " << inLen << ", out " << outLen;
+            }
+        }
+    }
+
+    TEST(Paging, Paged) {
+        uint8_t in[TX_MEMOLEN_MAX];
+        for (size_t i = 0; i < sizeof(in); i++) {
+            in[i] = 'a' + i % 26;
+        }
+
+        std::vector<char> out(256);
+        for (uint16_t outLen = 2; outLen < out.size(); outLen++) {
+            for (uint16_t inLen = 0; inLen <= sizeof(in); inLen++) {
+                const uint16_t pageLen = outLen - 1;
+                const uint8_t want = 1 + inLen / pageLen;
+                EXPECT_EQ(want, parser_pageCount(inLen, outLen)) << "in " << inLen << ", out " << outLen;
+
+                for (uint8_t page = 0; page < want; page++) {
+                    // leftovers of a previous page must not show
+                    memset(out.data(), 'x', out.size());
+                    uint8_t pageCount = 0;
+                    ASSERT_EQ(parser_ok, parser_arrayToString(out.data(), outLen, in, inLen, page, &pageCount));
+                    EXPECT_EQ(want, pageCount) << "in " << inLen << ", out " << outLen;
+
+                    const uint16_t offset = page * pageLen;
+                    const uint16_t len = inLen - offset < pageLen ? inLen - offset : pageLen;
+                    EXPECT_EQ(std::string((const char *) in + offset, len), out.data())
+                                        << "in " << inLen << ", out " << outLen << ", page " << (int) page;
+                }
+            }
+        }
+    }
+
+    TEST(CharClasses, EveryByteAtEveryPosition) {
+        for (int c = 0; c < 256; c++) {
+            const bool readable = c >= 33 && c <= 127;
+            const bool upper = c >= 'A' && c <= 'Z';
+            const bool chainID = (c >= 'a' && c <= 'z') || upper || (c >= '0' && c <= '9') ||
+                                 c == '_' || c == '.' || c == '-';
+            const struct {
+                uint8_t classes;
+                bool expected;
+            } cases[] = {
+                    {PARSER_CHARCLASS_READABLE, readable},
+                    {PARSER_CHARCLASS_UPPERCASE, upper},
+                    {PARSER_CHARCLASS_CHAINID, chainID},
+                    {PARSER_CHARCLASS_CHAINID | PARSER_CHARCLASS_READABLE, chainID && readable},
+            };
+            for (uint16_t len = 1; len <= 20; len++) {
+                for (uint16_t pos = 0; pos < len; pos++) {
+                    uint8_t span[20];
+                    memset(span, 'A', sizeof(span));
+                    span[pos] = (uint8_t) c;
+                    for (const auto &k : cases) {
+                        ASSERT_EQ(k.expected, parser_checkChars(span, len, k.classes) == parser_ok)
+                                            << "byte " << c << ", class " << (int) k.classes;
+                    }
+                }
+            }
+        }
+    }
+}
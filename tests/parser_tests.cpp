@@ -0,0 +1,308 @@
+/*******************************************************************************
+*   (c) 2019 ZondaX GmbH
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+********************************************************************************/
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "tx_builder.h"
+
+#include "parser.h"
+
+namespace {
+    // Display geometries as used by view_internal.h
+    struct screen_t {
+        const char *name;
+        uint16_t keyLen;
+        uint16_t valueLen;
+    };
+
+    const screen_t screens[] = {
+            {"nanos", 32 + 1, 2 * 18 + 1},
+            {"nanox", 64, 4096},
+    };
+
+    const bench::tx_spec_t simple = {"iov-lovenet", 1, 10, 0, 0, 10000000, "", 0};
+
+    ::testing::AssertionResult parse(const bench::bytes_t &tx, parser_context_t *ctx) {
+        parser_error_t err = parser_parse(ctx, (uint8_t *) tx.data(), tx.size());
+        if (err == parser_ok) {
+            err = parser_validate(bool_false);
+        }
+        if (err != parser_ok) {
+            return ::testing::AssertionFailure() << parser_getErrorDescription(err);
+        }
+        return ::testing::AssertionSuccess();
+    }
+
+    // Renders page 0 of every item with a large screen
+    std::vector<std::string> render_items(parser_context_t *ctx) {
+        std::vector<std::string> items;
+        char key[64], value[4096];
+        parser_resetRenderCache();
+        for (uint8_t idx = 0; idx < parser_getNumItems(ctx); idx++) {
+            uint8_t pageCount;
+            parser_getItem(ctx, idx, key, sizeof(key), value, sizeof(value), 0, &pageCount);
+            items.push_back(std::string(key) + "=" + value);
+        }
+        return items;
+    }
+
+    // Renders every page of every item, the same way the review flow walks a transaction
+    void render_all(parser_context_t *ctx, const screen_t &screen, char *key, char *value) {
+        const uint8_t numItems = parser_getNumItems(ctx);
+        for (uint8_t idx = 0; idx < numItems; idx++) {
+            uint8_t pageCount = 1;
+            for (uint8_t pageIdx = 0; pageIdx < pageCount; pageIdx++) {
+                parser_getItem(ctx, idx, key, screen.keyLen, value, screen.valueLen, pageIdx, &pageCount);
+            }
+        }
+    }
+
+    TEST(Parser, CorpusIsValid) {
+        parser_context_t ctx;
+        for (const auto &entry : bench::build_corpus()) {
+            EXPECT_TRUE(parse(entry.data, &ctx)) << entry.name;
+        }
+    }
+
+    TEST(Parser, VersionRejectedOnFirstChunk) {
+        bench::bytes_t tx = bench::build_tx(simple);
+        tx[1] = 0xCB;
+
+        // Nothing to check until the 4 version bytes have arrived
+        parser_context_t ctx;
+        parser_init(&ctx, nullptr, 0);
+        EXPECT_EQ(parser_ok, parser_parseChunk(&ctx, tx.data(), 3));
+        EXPECT_EQ(parser_unexpected_version, parser_parseChunk(&ctx, tx.data(), 4))
+                            << "The rest of the header should not be needed";
+    }
+
+    TEST(Parser, VersionCheckedBeforeChainID) {
+        bench::bytes_t tx = bench::build_tx({"iov lovenet", 1, 10, 0, 0, 10000000, "", 0});
+        parser_context_t ctx;
+        EXPECT_EQ(parser_unexpected_characters, parser_parse(&ctx, tx.data(), tx.size()));
+
+        tx[1] = 0xCB;
+        EXPECT_EQ(parser_unexpected_version, parser_parse(&ctx, tx.data(), tx.size()));
+    }
+
+    TEST(Parser, MultisigEntriesInAnyOrder) {
+        // Two entries between fees and the message, a third one after it
+        bench::bytes_t tx = bench::build_tx({"iov-lovenet", 1, 10, 0, 0, 10000000, "", 2});
+        bench::bytes_t contract(8);
+        for (uint8_t j = 0; j < 8; j++) {
+            contract[j] = (uint8_t) (0xA0 + j);
+        }
+        bench::pb_bytes(tx, PBIDX_TX_MULTISIG, contract);
+
+        parser_context_t ctx;
+        ASSERT_TRUE(parse(tx, &ctx));
+        ASSERT_EQ(3, parser_tx_obj.multisig.count) << "Wrong number of entries";
+
+        const uint64_t want[] = {0x0001020304050607u, 0x08090A0B0C0D0E0Fu, 0xA0A1A2A3A4A5A6A7u};
+        const uint8_t order[] = {0, 1, 2, 2, 1, 0, 2, 0, 1};
+        for (const uint8_t idx : order) {
+            uint64_t value = 0;
+            EXPECT_EQ(parser_ok, parser_getMultisig(idx, &value)) << "Entry " << (int) idx;
+            EXPECT_EQ(want[idx], value) << "Wrong entry " << (int) idx;
+        }
+
+        uint64_t value;
+        EXPECT_EQ(parser_no_data, parser_getMultisig(3, &value)) << "Entry past the end";
+    }
+
+    TEST(Parser, MultisigItemsAfterIndexedOnes) {
+        bench::bytes_t tx = bench::build_tx({"iov-lovenet", 1, 10, 0, 0, 10000000, "", 2});
+        bench::bytes_t contract(8);
+        for (uint8_t j = 0; j < 8; j++) {
+            contract[j] = (uint8_t) (0xA0 + j);
+        }
+        bench::pb_bytes(tx, PBIDX_TX_MULTISIG, contract);
+
+        parser_context_t ctx;
+        ASSERT_TRUE(parse(tx, &ctx));
+
+        char key[64], value[32];
+        uint8_t pageCount;
+        const uint8_t numItems = parser_getNumItems(&ctx);
+        ASSERT_EQ(parser_ok, parser_getItem(&ctx, numItems - 1, key, sizeof(key), value, sizeof(value),
+                                            0, &pageCount));
+        EXPECT_STREQ("Multisig [3/3]", key);
+        EXPECT_STREQ("11574711341044573863", value);
+    }
+
+    TEST(Parser, MultisigTooManyEntries) {
+        parser_context_t ctx;
+        const auto tx = bench::build_tx({"iov-lovenet", 1, 10, 0, 0, 10000000, "", PBIDX_MULTISIG_COUNT_MAX});
+        EXPECT_TRUE(parse(tx, &ctx)) << "Up to PBIDX_MULTISIG_COUNT_MAX entries are accepted";
+
+        const auto tooMany = bench::build_tx({"iov-lovenet", 1, 10, 0, 0, 10000000, "",
+                                              PBIDX_MULTISIG_COUNT_MAX + 1});
+        EXPECT_EQ(parser_value_out_of_range, parser_parse(&ctx, (uint8_t *) tooMany.data(), tooMany.size()));
+    }
+
+    TEST(Parser, TickerRejected) {
+        parser_context_t ctx;
+        const char *rejected[] = {nullptr, "", "AB", "ABCDE", "ABCDEF"};
+        for (const char *ticker : rejected) {
+            const auto tx = bench::build_tx(simple, ticker);
+            EXPECT_EQ(parser_value_out_of_range, parser_parse(&ctx, (uint8_t *) tx.data(), tx.size()))
+                                << (ticker != nullptr ? ticker : "(none)") << " accepted";
+        }
+    }
+
+    TEST(Parser, TickerAccepted) {
+        parser_context_t ctx;
+        for (const char *ticker : {"ABC", "ABCD"}) {
+            EXPECT_TRUE(parse(bench::build_tx(simple, ticker), &ctx)) << ticker << " rejected";
+        }
+    }
+
+    // Pages served from the render cache must match items rendered from scratch
+    TEST(Parser, RenderCacheMatchesFreshRender) {
+        parser_context_t ctx;
+        std::vector<char> key(4096), value(4096);
+        std::vector<char> wantKey(4096), wantValue(4096);
+
+        for (const auto &entry : bench::build_corpus()) {
+            ASSERT_TRUE(parse(entry.data, &ctx)) << entry.name;
+
+            for (const auto &screen : screens) {
+                const uint8_t numItems = parser_getNumItems(&ctx);
+                for (uint8_t idx = 0; idx < numItems; idx++) {
+                    uint8_t pageCount = 1;
+                    for (uint8_t pageIdx = 0; pageIdx < pageCount; pageIdx++) {
+                        uint8_t wantPageCount;
+                        parser_resetRenderCache();
+                        const parser_error_t wantErr = parser_getItem(&ctx, idx,
+                                                                      wantKey.data(), screen.keyLen,
+                                                                      wantValue.data(), screen.valueLen,
+                                                                      pageIdx, &wantPageCount);
+
+                        // Warm the cache with every other item before asking again
+                        render_all(&ctx, screen, key.data(), value.data());
+                        const parser_error_t err = parser_getItem(&ctx, idx,
+                                                                  key.data(), screen.keyLen,
+                                                                  value.data(), screen.valueLen,
+                                                                  pageIdx, &pageCount);
+
+                        ASSERT_EQ(wantErr, err) << entry.name << " item " << (int) idx << " [" << screen.name << "]";
+                        ASSERT_EQ(wantPageCount, pageCount) << entry.name << " item " << (int) idx;
+                        ASSERT_STREQ(wantKey.data(), key.data()) << entry.name << " page " << (int) pageIdx;
+                        ASSERT_STREQ(wantValue.data(), value.data()) << entry.name << " page " << (int) pageIdx;
+                    }
+                }
+            }
+        }
+    }
+
+    // Page counts are known without rendering and must match the rendered items
+    TEST(Parser, PageCountsMatchRenderedItems) {
+        // Memos whose length in bytes would give more pages than once they are shown
+        std::vector<bench::corpus_entry_t> entries = bench::build_corpus();
+        const std::string text(30, 'x');
+        const std::string memos[] = {"\x01tab\tbell\x07", text + "\xF0\x9F\x98\x80\xE5\x93\x88",
+                                     text + "pi\xC3\xB1" "ata", text + " not utf8 \x80"};
+        for (const auto &memo : memos) {
+            entries.push_back({"memo", bench::build_tx({"iov-lovenet", 1, 10, 0, 0, 10000000, memo, 0})});
+        }
+
+        parser_context_t ctx;
+        std::vector<char> key(4096), value(4096);
+        for (const auto &entry : entries) {
+            ASSERT_TRUE(parse(entry.data, &ctx)) << entry.name;
+
+            for (const auto &screen : screens) {
+                const uint8_t numItems = parser_getNumItems(&ctx);
+                for (uint8_t idx = 0; idx <= numItems; idx++) {
+                    uint8_t want, have;
+                    const parser_error_t wantErr = parser_getItem(&ctx, idx,
+                                                                  key.data(), screen.keyLen,
+                                                                  value.data(), screen.valueLen,
+                                                                  0, &want);
+                    EXPECT_EQ(wantErr, parser_getItemPageCount(idx, screen.valueLen, &have))
+                                        << entry.name << " item " << (int) idx << " [" << screen.name << "]";
+                    EXPECT_EQ(want, have) << entry.name << " item " << (int) idx << " [" << screen.name << "]";
+                }
+            }
+        }
+    }
+
+    TEST(Parser, AddressLenMatchesEncoder) {
+        // Every payload length, including those too long to be encoded
+        uint8_t payload[80] = {};
+        char address[128];
+        for (uint16_t len = 0; len <= sizeof(payload); len++) {
+            const parser_span_t span = {0, len};
+            ASSERT_EQ(parser_ok, parser_getAddress(parser_getHRP(), address, sizeof(address), payload, len));
+            EXPECT_EQ(strlen(address), parser_addressLen(&span)) << "Wrong length for " << len << " bytes";
+        }
+    }
+
+    // Incremental parsing must give the same result no matter how the buffer is split
+    TEST(Parser, StreamingMatchesWholeBuffer) {
+        parser_context_t ctx;
+        for (const auto &entry : bench::build_corpus()) {
+            ASSERT_TRUE(parse(entry.data, &ctx)) << entry.name;
+            const auto want = render_items(&ctx);
+
+            const uint16_t size = entry.data.size();
+            for (uint16_t chunkSize = 1; chunkSize <= size; chunkSize++) {
+                parser_init(&ctx, nullptr, 0);
+                for (uint16_t received = chunkSize; received < size; received += chunkSize) {
+                    parser_parseChunk(&ctx, entry.data.data(), received);
+                }
+                ASSERT_EQ(parser_ok, parser_parseEnd(&ctx, entry.data.data(), size))
+                                    << entry.name << ", " << chunkSize << " byte chunks";
+                ASSERT_EQ(parser_ok, parser_validate(bool_false)) << entry.name << ", " << chunkSize << " byte chunks";
+                ASSERT_EQ(want, render_items(&ctx)) << entry.name << ", " << chunkSize << " byte chunks";
+            }
+        }
+    }
+
+    // A transaction split between two memory areas (RAM and flash) must parse as if it was contiguous
+    TEST(Parser, SegmentsMatchContiguousBuffer) {
+        parser_context_t ctx;
+        for (const auto &entry : bench::build_corpus()) {
+            ASSERT_TRUE(parse(entry.data, &ctx)) << entry.name;
+            const auto want = render_items(&ctx);
+
+            const uint16_t size = entry.data.size();
+            for (uint16_t split = 1; split < size; split++) {
+                // Separate allocations, so a read past the head cannot hit the tail by accident
+                const bench::bytes_t head(entry.data.begin(), entry.data.begin() + split);
+                const bench::bytes_t tail(entry.data.begin() + split, entry.data.end());
+                const segments_t segments = {head.data(), split, tail.data(), (uint16_t) tail.size()};
+                parser_setSegments(&segments);
+
+                for (const uint16_t chunkSize : {size, (uint16_t) 13}) {
+                    parser_init(&ctx, nullptr, 0);
+                    for (uint16_t received = chunkSize; received < size; received += chunkSize) {
+                        parser_parseChunk(&ctx, head.data(), received);
+                    }
+                    const parser_error_t err = parser_parseEnd(&ctx, head.data(), size);
+                    EXPECT_EQ(parser_ok, err) << entry.name << ", split at " << split;
+                    EXPECT_EQ(parser_ok, err == parser_ok ? parser_validate(bool_false) : err)
+                                        << entry.name << ", split at " << split;
+                    EXPECT_EQ(want, render_items(&ctx)) << entry.name << ", split at " << split
+                                                        << ", " << chunkSize << " byte chunks";
+                }
+            }
+            parser_setSegments(nullptr);
+        }
+    }
+}